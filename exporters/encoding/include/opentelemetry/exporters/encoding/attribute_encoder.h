@@ -0,0 +1,94 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include "opentelemetry/common/attribute_value.h"
+#include "opentelemetry/nostd/span.h"
+#include "opentelemetry/nostd/string_view.h"
+#include "opentelemetry/nostd/variant.h"
+#include "opentelemetry/sdk/common/attribute_utils.h"
+#include "opentelemetry/version.h"
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter {
+namespace encoding {
+
+/**
+ * Visitor dispatching every alternative of AttributeValue and
+ * OwnedAttributeValue onto an output Sink at compile time. Shared by the
+ * fluentd (Geneva logs and traces), Geneva metrics and user_events exporters.
+ *
+ * A Sink provides:
+ * - AddScalar(key, T) for bool and every integral / floating point type,
+ * - AddString(key, nostd::string_view),
+ * - AddArray(key, first, last) for numeric arrays. Contiguous alternatives
+ *   are passed as `const T *` so that a sink may bulk-copy them,
+ * - AddStringArray(key, first, last) over nostd::string_view or std::string.
+ */
+template <class Sink> class AttributeEncoder {
+public:
+  AttributeEncoder(Sink &sink, nostd::string_view key) noexcept
+      : sink_(sink), key_(key) {}
+
+  template <class T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  operator()(T value) {
+    sink_.AddScalar(key_, value);
+  }
+
+  void operator()(const char *value) {
+    sink_.AddString(key_, nostd::string_view(value));
+  }
+
+  void operator()(nostd::string_view value) { sink_.AddString(key_, value); }
+
+  void operator()(const std::string &value) {
+    sink_.AddString(key_, nostd::string_view(value.data(), value.size()));
+  }
+
+  template <class T> void operator()(nostd::span<const T> values) {
+    sink_.AddArray(key_, values.data(), values.data() + values.size());
+  }
+
+  void operator()(nostd::span<const nostd::string_view> values) {
+    sink_.AddStringArray(key_, values.data(), values.data() + values.size());
+  }
+
+  template <class T> void operator()(const std::vector<T> &values) {
+    sink_.AddArray(key_, values.data(), values.data() + values.size());
+  }
+
+  // std::vector<bool> is bit-packed and has no contiguous storage.
+  void operator()(const std::vector<bool> &values) {
+    sink_.AddArray(key_, values.begin(), values.end());
+  }
+
+  void operator()(const std::vector<std::string> &values) {
+    sink_.AddStringArray(key_, values.data(), values.data() + values.size());
+  }
+
+private:
+  Sink &sink_;
+  nostd::string_view key_;
+};
+
+template <class Sink>
+inline void EncodeAttribute(Sink &sink, nostd::string_view key,
+                            const opentelemetry::common::AttributeValue &value) {
+  nostd::visit(AttributeEncoder<Sink>(sink, key), value);
+}
+
+template <class Sink>
+inline void
+EncodeAttribute(Sink &sink, nostd::string_view key,
+                const opentelemetry::sdk::common::OwnedAttributeValue &value) {
+  nostd::visit(AttributeEncoder<Sink>(sink, key), value);
+}
+
+} // namespace encoding
+} // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
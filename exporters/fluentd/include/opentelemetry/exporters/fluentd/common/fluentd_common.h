@@ -5,6 +5,7 @@
 
 #include "opentelemetry/common/attribute_value.h"
 #include "opentelemetry/sdk/common/attribute_utils.h"
+#include "opentelemetry/exporters/encoding/attribute_encoder.h"
 #include "opentelemetry/exporters/fluentd/common/fluentd_logging.h"
 #include "opentelemetry/nostd/string_view.h"
 #include "opentelemetry/version.h"
@@ -12,6 +13,8 @@
 #include "nlohmann/json.hpp"
 
 #include <chrono>
+#include <string>
+#include <vector>
 
 #ifndef ENABLE_LOGS_PREVIEW
 #define ENABLE_LOGS_PREVIEW 1
@@ -25,6 +28,46 @@ using FluentdLog = nlohmann::json;
 
 constexpr int kAttributeValueSize = 15;
 
+/**
+ * Attribute sink writing into a JSON object which is later packed to msgpack.
+ * Arrays are built in one allocation from the source range instead of being
+ * appended element by element through the parent object.
+ */
+class JsonAttributeSink {
+public:
+  explicit JsonAttributeSink(nlohmann::json &attributes) noexcept
+      : attributes_(attributes) {}
+
+  template <class T> void AddScalar(nostd::string_view key, T value) {
+    Slot(key) = value;
+  }
+
+  void AddString(nostd::string_view key, nostd::string_view value) {
+    Slot(key) = std::string(value.data(), value.size());
+  }
+
+  template <class It> void AddArray(nostd::string_view key, It first, It last) {
+    Slot(key) = nlohmann::json::array_t(first, last);
+  }
+
+  template <class T>
+  void AddStringArray(nostd::string_view key, const T *first, const T *last) {
+    nlohmann::json::array_t values;
+    values.reserve(static_cast<size_t>(last - first));
+    for (; first != last; ++first) {
+      values.emplace_back(std::string(first->data(), first->size()));
+    }
+    Slot(key) = std::move(values);
+  }
+
+private:
+  nlohmann::json &Slot(nostd::string_view key) {
+    return attributes_[std::string(key.data(), key.size())];
+  }
+
+  nlohmann::json &attributes_;
+};
+
 void inline PopulateAttribute(
     nlohmann::json &attribute, nostd::string_view key,
     const opentelemetry::common::AttributeValue &value) {
@@ -35,69 +78,8 @@ void inline PopulateAttribute(
           kAttributeValueSize + 1,
       "AttributeValue contains unknown type");
 
-  if (nostd::holds_alternative<bool>(value)) {
-    attribute[key.data()] = nostd::get<bool>(value);
-  } else if (nostd::holds_alternative<int>(value)) {
-    attribute[key.data()] = nostd::get<int>(value);
-  } else if (nostd::holds_alternative<int64_t>(value)) {
-    attribute[key.data()] = nostd::get<int64_t>(value);
-  } else if (nostd::holds_alternative<unsigned int>(value)) {
-    attribute[key.data()] = nostd::get<unsigned int>(value);
-  } else if (nostd::holds_alternative<uint64_t>(value)) {
-    attribute[key.data()] = nostd::get<uint64_t>(value);
-  } else if (nostd::holds_alternative<double>(value)) {
-    attribute[key.data()] = nostd::get<double>(value);
-  } else if (nostd::holds_alternative<const char *>(value)) {
-    attribute[key.data()] = std::string(nostd::get<const char *>(value));
-
-  } else if (nostd::holds_alternative<nostd::string_view>(value)) {
-    attribute[key.data()] =
-        std::string(nostd::get<nostd::string_view>(value).data());
-    // nostd::string_view(nostd::get<nostd::string_view>(value).data(),
-    // nostd::get<nostd::string_view>(value).size());
-  } else if (nostd::holds_alternative<nostd::span<const uint8_t>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const uint8_t>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const bool>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const bool>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const int>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const int>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const int64_t>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const int64_t>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const unsigned int>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const unsigned int>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const uint64_t>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const uint64_t>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const double>>(value)) {
-    attribute[key.data()] = {};
-    for (const auto &val : nostd::get<nostd::span<const double>>(value)) {
-      attribute[key.data()].push_back(val);
-    }
-  } else if (nostd::holds_alternative<nostd::span<const nostd::string_view>>(
-                 value)) {
-    attribute[key.data()] = {};
-    for (const auto &val :
-         nostd::get<nostd::span<const nostd::string_view>>(value)) {
-      attribute[key.data()].push_back(std::string(val.data(), val.size()));
-    }
-  }
+  JsonAttributeSink sink(attribute);
+  encoding::EncodeAttribute(sink, key, value);
 }
 
 void inline PopulateOwnedAttribute(
@@ -110,81 +92,8 @@ void inline PopulateOwnedAttribute(
           kAttributeValueSize + 1,
       "AttributeValue contains unknown type");
 
-  namespace common = opentelemetry::sdk::common;
-  switch(value.index()) {
-    case common::kTypeBool:
-      attribute[key.data()] = nostd::get<bool>(value);
-      break;
-    case common::kTypeInt:
-      attribute[key.data()] = nostd::get<int>(value);
-      break;
-    case common::kTypeUInt:
-      attribute[key.data()] = nostd::get<unsigned int>(value);
-      break;
-    case common::kTypeInt64:
-      attribute[key.data()] = nostd::get<int64_t>(value);
-      break;
-    case common::kTypeDouble:
-      attribute[key.data()] = nostd::get<double>(value);
-      break;
-    case common::kTypeString:
-      attribute[key.data()] = nostd::get<std::string>(value);
-      break;
-    case common::kTypeSpanBool:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<bool>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeSpanInt:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<int>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeSpanUInt:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<unsigned int>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeSpanInt64:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<int64_t>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeSpanDouble:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<double>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeSpanString:
-      attribute[key.data()] = {};
-      for (const auto &val :
-          nostd::get<std::vector<std::string>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeUInt64:
-      attribute[key.data()] = nostd::get<uint64_t>(value);
-      break;
-    case common::kTypeSpanUInt64:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<uint64_t>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    case common::kTypeSpanByte:
-      attribute[key.data()] = {};
-      for (const auto &val : nostd::get<std::vector<uint8_t>>(value)) {
-        attribute[key.data()].push_back(val);
-      }
-      break;
-    default:
-      break;
-  }
+  JsonAttributeSink sink(attribute);
+  encoding::EncodeAttribute(sink, key, value);
 }
 
 inline std::string AttributeValueToString(
@@ -221,6 +130,14 @@ enum class TransportFormat {
   kCompressedPackedForward
 };
 
+/**
+ * Policy used to spread packets across several fluentd endpoints.
+ */
+enum class LoadBalancing {
+  kRoundRobin,  // rotate through healthy endpoints
+  kLeastPending // pick the healthy endpoint with fewest in-flight packets
+};
+
 /**
  * Struct to hold fluentd  exporter options.
  */
@@ -231,6 +148,14 @@ struct FluentdExporterOptions {
   std::string tag = "tag.service";
   size_t retry_count = 2; // number of retries before drop
   std::string endpoint;
+  // Additional endpoints for load balancing and failover. `endpoint`, when
+  // set, is always used as the first entry.
+  std::vector<std::string> endpoints;
+  LoadBalancing load_balancing = LoadBalancing::kRoundRobin;
+  // Backoff applied to an endpoint after a failed delivery. It doubles on
+  // every consecutive failure up to retry_backoff_max.
+  std::chrono::milliseconds retry_backoff_initial{100};
+  std::chrono::milliseconds retry_backoff_max{5000};
   bool convert_event_to_trace =
       false; // convert events to trace. Not used for Logs.
   bool include_trace_state_for_span = false;
@@ -0,0 +1,360 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include "opentelemetry/exporters/fluentd/common/fluentd_common.h"
+#include "opentelemetry/exporters/fluentd/common/fluentd_logging.h"
+#include "opentelemetry/exporters/fluentd/common/socket_tools.h"
+#include "opentelemetry/ext/http/common/url_parser.h"
+#include "opentelemetry/nostd/unique_ptr.h"
+#include "opentelemetry/version.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter {
+namespace fluentd {
+namespace common {
+
+/**
+ * @brief Scheme for tcp:// stream
+ */
+constexpr const char *kEndpointSchemeTCP = "tcp";
+
+/**
+ * @brief Scheme for udp:// datagram
+ */
+constexpr const char *kEndpointSchemeUDP = "udp";
+
+/**
+ * @brief Scheme for unix:// domain socket
+ */
+constexpr const char *kEndpointSchemeUNIX = "unix";
+
+/**
+ * @brief Single fluentd node along with its health and load state.
+ */
+struct FluentdEndpoint {
+  using Clock = std::chrono::steady_clock;
+
+  std::string url;
+  SocketTools::SocketParams params{AF_INET, SOCK_STREAM, 0};
+  nostd::unique_ptr<SocketTools::SocketAddr> addr;
+
+  // Connection kept open between packets, guarded by lock.
+  std::mutex lock;
+  SocketTools::Socket socket;
+  bool connected = false;
+
+  // Number of packets currently being written to this endpoint.
+  std::atomic<size_t> pending{0};
+  // Number of consecutive failed deliveries. Zero means healthy.
+  std::atomic<uint32_t> failures{0};
+  // Steady clock tick (ns) before which the endpoint must not be retried.
+  std::atomic<int64_t> retry_after{0};
+
+  ~FluentdEndpoint() {
+    if (connected) {
+      socket.close();
+    }
+  }
+
+  bool Healthy(int64_t now) const noexcept {
+    return failures.load(std::memory_order_relaxed) == 0 ||
+           retry_after.load(std::memory_order_relaxed) <= now;
+  }
+};
+
+/**
+ * @brief Set of fluentd endpoints shared by an exporter instance.
+ *
+ * Packets are dispatched to one endpoint selected by the configured
+ * LoadBalancing policy. An endpoint that fails to accept a connection or a
+ * full write is put into exponential backoff and the packet fails over to
+ * the next healthy endpoint. Every endpoint keeps its connection open
+ * between packets; Send may be called concurrently, deliveries to the same
+ * endpoint are serialized.
+ */
+class FluentdEndpointPool {
+public:
+  using Clock = FluentdEndpoint::Clock;
+
+  explicit FluentdEndpointPool(const FluentdExporterOptions &options)
+      : retry_count_(options.retry_count),
+        load_balancing_(options.load_balancing),
+        backoff_initial_(options.retry_backoff_initial),
+        backoff_max_(options.retry_backoff_max) {
+    std::vector<std::string> urls;
+    if (!options.endpoint.empty() || options.endpoints.empty()) {
+      urls.push_back(options.endpoint);
+    }
+    for (const auto &url : options.endpoints) {
+      if (!url.empty() &&
+          std::find(urls.begin(), urls.end(), url) == urls.end()) {
+        urls.push_back(url);
+      }
+    }
+    endpoints_.reserve(urls.size());
+    for (const auto &url : urls) {
+      std::unique_ptr<FluentdEndpoint> endpoint(new FluentdEndpoint());
+      if (Initialize(url, *endpoint)) {
+        endpoints_.push_back(std::move(endpoint));
+      }
+    }
+  }
+
+  /**
+   * @brief Number of endpoints accepted from the configuration.
+   */
+  size_t size() const noexcept { return endpoints_.size(); }
+
+  /**
+   * @brief Check whether an endpoint is currently accepting traffic.
+   * @param index endpoint position in configuration order
+   */
+  bool IsHealthy(size_t index) const noexcept {
+    return index < endpoints_.size() && endpoints_[index]->Healthy(Now());
+  }
+
+  /**
+   * @brief Try to upload fluentd forward protocol packet.
+   * Up to retry_count attempts are made. A failed endpoint is skipped until
+   * its backoff elapses; when no endpoint is healthy the one recovering
+   * first is tried right away. Send never sleeps, so it blocks the export
+   * thread for at most retry_count connection attempts.
+   *
+   * @param packet
+   * @return true if packet got delivered.
+   */
+  bool Send(const std::vector<uint8_t> &packet) {
+    if (endpoints_.empty()) {
+      LOG_ERROR("send failed, no valid endpoint!");
+      return false;
+    }
+    size_t retryCount = retry_count_;
+    while (retryCount--) {
+      FluentdEndpoint &endpoint = Select();
+
+      endpoint.pending.fetch_add(1, std::memory_order_relaxed);
+      bool delivered = Deliver(endpoint, packet);
+      endpoint.pending.fetch_sub(1, std::memory_order_relaxed);
+
+      if (delivered) {
+        if (endpoint.failures.exchange(0, std::memory_order_relaxed) != 0) {
+          LOG_INFO("endpoint %s recovered", endpoint.url.c_str());
+        }
+        LOG_DEBUG("send successful");
+        return true;
+      }
+
+      MarkFailed(endpoint);
+      LOG_WARN("send to %s failed, retrying %u ...", endpoint.url.c_str(),
+               (unsigned int)retryCount);
+    }
+
+    LOG_ERROR("send failed!");
+    return false;
+  }
+
+protected:
+  static int64_t Now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+  }
+
+  /**
+   * @brief Parse endpoint URL and resolve its socket address.
+   * @return true if end-point settings have been accepted.
+   */
+  static bool Initialize(const std::string &url, FluentdEndpoint &endpoint) {
+    opentelemetry::ext::http::common::UrlParser parser(url);
+    bool is_unix_domain = false;
+
+    if (parser.scheme_ == kEndpointSchemeTCP) {
+      endpoint.params = {AF_INET, SOCK_STREAM, 0};
+    } else if (parser.scheme_ == kEndpointSchemeUDP) {
+      endpoint.params = {AF_INET, SOCK_DGRAM, 0};
+    }
+#ifdef HAVE_UNIX_DOMAIN
+    else if (parser.scheme_ == kEndpointSchemeUNIX) {
+      endpoint.params = {AF_UNIX, SOCK_STREAM, 0};
+      is_unix_domain = true;
+    }
+#endif
+    else {
+#if defined(__EXCEPTIONS)
+      // Customers MUST specify valid end-point configuration
+      throw std::runtime_error("Invalid endpoint!");
+#endif
+      return false;
+    }
+
+    endpoint.url = url;
+    endpoint.addr.reset(new SocketTools::SocketAddr(url.c_str(), is_unix_domain));
+    if (endpoint.addr->m_data_in.sin_family != AF_UNIX &&
+        endpoint.addr->m_data_in.sin_family != AF_INET &&
+        endpoint.addr->m_data_in.sin_family != AF_INET6) {
+      LOG_ERROR("Invalid endpoint! %s", url.c_str());
+      return false;
+    }
+    LOG_TRACE("using endpoint %s", endpoint.addr->toString().c_str());
+    return true;
+  }
+
+  /**
+   * @brief Pick the endpoint for the next attempt. Healthy endpoints are
+   * preferred; if none is healthy, the one recovering first is returned.
+   */
+  FluentdEndpoint &Select() noexcept {
+    const int64_t now = Now();
+    const size_t count = endpoints_.size();
+    const size_t start =
+        next_.fetch_add(1, std::memory_order_relaxed) % count;
+
+    FluentdEndpoint *best = nullptr;
+    FluentdEndpoint *earliest = nullptr;
+    for (size_t i = 0; i < count; i++) {
+      FluentdEndpoint *candidate = endpoints_[(start + i) % count].get();
+      if (!candidate->Healthy(now)) {
+        if (earliest == nullptr ||
+            candidate->retry_after.load(std::memory_order_relaxed) <
+                earliest->retry_after.load(std::memory_order_relaxed)) {
+          earliest = candidate;
+        }
+        continue;
+      }
+      if (load_balancing_ == LoadBalancing::kRoundRobin) {
+        return *candidate;
+      }
+      if (best == nullptr ||
+          candidate->pending.load(std::memory_order_relaxed) <
+              best->pending.load(std::memory_order_relaxed)) {
+        best = candidate;
+      }
+    }
+    return (best != nullptr) ? *best : *earliest;
+  }
+
+  /**
+   * @brief Put endpoint into exponential backoff after a failed delivery.
+   */
+  void MarkFailed(FluentdEndpoint &endpoint) noexcept {
+    uint32_t failures =
+        endpoint.failures.fetch_add(1, std::memory_order_relaxed);
+    auto backoff = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        backoff_initial_);
+    auto limit =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(backoff_max_);
+    for (uint32_t i = 0; i < failures && backoff < limit; i++) {
+      backoff *= 2;
+    }
+    backoff = (std::min)(backoff, limit);
+    endpoint.retry_after.store(Now() + backoff.count(),
+                               std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Write the whole packet on the connection of the endpoint,
+   * connecting first if needed. A connection reused from a previous packet
+   * which turns out to be broken is replaced once.
+   * @return true if packet got delivered.
+   */
+  static bool Deliver(FluentdEndpoint &endpoint,
+                      const std::vector<uint8_t> &packet) {
+    std::lock_guard<std::mutex> guard(endpoint.lock);
+
+    bool reused = endpoint.connected && IsAlive(endpoint);
+    if (!reused) {
+      Disconnect(endpoint);
+      if (!Connect(endpoint)) {
+        return false;
+      }
+    }
+
+    if (endpoint.socket.writeall(packet) == packet.size()) {
+      return true;
+    }
+    Disconnect(endpoint);
+
+    if (!reused || !Connect(endpoint)) {
+      return false;
+    }
+    if (endpoint.socket.writeall(packet) == packet.size()) {
+      return true;
+    }
+    Disconnect(endpoint);
+    return false;
+  }
+
+  static bool Connect(FluentdEndpoint &endpoint) {
+    endpoint.socket = SocketTools::Socket(endpoint.params);
+    if (endpoint.socket.invalid()) {
+      LOG_ERROR("Unable to create socket for %s", endpoint.url.c_str());
+      return false;
+    }
+    if (!endpoint.socket.connect(*endpoint.addr)) {
+      LOG_ERROR("Unable to connect to %s", endpoint.url.c_str());
+      // Close the socket to avoid leaking file descriptors on failure.
+      endpoint.socket.close();
+      return false;
+    }
+    endpoint.connected = true;
+    LOG_DEBUG("socket connected");
+    return true;
+  }
+
+  static void Disconnect(FluentdEndpoint &endpoint) {
+    if (endpoint.connected) {
+      endpoint.connected = false;
+      endpoint.socket.close();
+      LOG_DEBUG("socket disconnected");
+    }
+  }
+
+  /**
+   * @brief Check a kept connection before writing to it. fluentd only
+   * answers when acks are requested, anything readable is discarded; an
+   * orderly shutdown of the peer means the connection is gone.
+   */
+  static bool IsAlive(FluentdEndpoint &endpoint) {
+    int error_code = 0;
+    endpoint.socket.getsockopt(SOL_SOCKET, SO_ERROR, error_code);
+    if (error_code != 0) {
+      return false;
+    }
+#ifdef MSG_DONTWAIT
+    if (endpoint.params.type == SOCK_STREAM) {
+      char buffer[256];
+      int received;
+      while ((received = endpoint.socket.recv(buffer, sizeof(buffer),
+                                              MSG_DONTWAIT)) > 0) {
+      }
+      return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+#endif
+    return true;
+  }
+
+  size_t retry_count_;
+  LoadBalancing load_balancing_;
+  std::chrono::milliseconds backoff_initial_;
+  std::chrono::milliseconds backoff_max_;
+  std::atomic<size_t> next_{0};
+  std::vector<std::unique_ptr<FluentdEndpoint>> endpoints_;
+};
+
+} // namespace common
+} // namespace fluentd
+} // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
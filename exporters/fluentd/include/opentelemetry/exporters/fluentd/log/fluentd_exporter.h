@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "opentelemetry/exporters/fluentd/common/fluentd_endpoint_pool.h"
 #include "opentelemetry/exporters/fluentd/common/socket_tools.h"
 
 #include "opentelemetry/exporters/fluentd/trace/recordable.h"
@@ -68,18 +69,12 @@ class FluentdExporter final : public logs_sdk::LogRecordExporter {
   bool Initialize();
   bool Send(std::vector<uint8_t> &packet);
 
-  // Connectivity management. One end-point per exporter instance.
-  bool Connect();
-  bool Disconnect();
-
-  // Socket connection is re-established for every batch of events
-  SocketTools::Socket socket_;
-  SocketTools::SocketParams socketparams_{AF_INET, SOCK_STREAM, 0};
-
   fluentd_common::FluentdExporterOptions options_;
   bool is_shutdown_{false};
-  nostd::unique_ptr<SocketTools::SocketAddr> addr_;
-  bool connected_{false};
+
+  // Connectivity management. Every endpoint keeps its connection between
+  // batches, the load balancing policy picks the endpoint of each batch.
+  std::unique_ptr<fluentd_common::FluentdEndpointPool> endpoints_;
 };
 
 } // namespace logs
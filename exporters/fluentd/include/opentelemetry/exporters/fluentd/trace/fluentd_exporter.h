@@ -3,6 +3,7 @@
 #pragma once
 
 #include "opentelemetry/exporters/fluentd/common/fluentd_common.h"
+#include "opentelemetry/exporters/fluentd/common/fluentd_endpoint_pool.h"
 #include "opentelemetry/exporters/fluentd/common/socket_tools.h"
 #include "opentelemetry/exporters/fluentd/trace/recordable.h"
 #include "opentelemetry/ext/http/common/url_parser.h"
@@ -75,14 +76,9 @@ class FluentdExporter final : public trace_sdk::SpanExporter {
   fluentd_common::FluentdExporterOptions options_;
   bool is_shutdown_{false};
 
-  // Connectivity management. One end-point per exporter instance.
-  bool Connect();
-  bool Disconnect();
-  bool connected_{false};
-  // Socket connection is re-established for every batch of events
-  SocketTools::Socket socket_;
-  SocketTools::SocketParams socketparams_{AF_INET, SOCK_STREAM, 0};
-  nostd::unique_ptr<SocketTools::SocketAddr> addr_;
+  // Connectivity management. Every endpoint keeps its connection between
+  // batches, the load balancing policy picks the endpoint of each batch.
+  std::unique_ptr<fluentd_common::FluentdEndpointPool> endpoints_;
 };
 
 } // namespace trace
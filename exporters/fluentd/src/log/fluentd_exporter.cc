@@ -21,21 +21,6 @@ using UrlParser = opentelemetry::ext::http::common::UrlParser;
 
 using namespace nlohmann;
 
-/**
- * @brief Scheme for tcp:// stream
- */
-constexpr const char *kTCP = "tcp";
-
-/**
- * @brief Scheme for udp:// datagram
- */
-constexpr const char *kUDP = "udp";
-
-/**
- * @brief Scheme for unix:// domain socket
- */
-constexpr const char *kUNIX = "unix";
-
 /**
  * @brief Create FluentD exporter with options
  * @param options
@@ -116,123 +101,30 @@ sdk::common::ExportResult FluentdExporter::Export(
 
 /**
  * @brief Try to upload fluentd forward protocol packet.
- * This method respects the retry options for connects
- * and upload retries.
+ * This method respects the retry and backoff options for connects
+ * and upload retries, failing over across configured endpoints.
  *
  * @param packet
  * @return true if packet got delivered.
  */
 bool FluentdExporter::Send(std::vector<uint8_t> &packet) {
-  size_t retryCount = options_.retry_count;
-  while (retryCount--) {
-    int error_code = 0;
-    // Check if socket is Okay
-    if (connected_) {
-      socket_.getsockopt(SOL_SOCKET, SO_ERROR, error_code);
-      if (error_code != 0) {
-        connected_ = false;
-      }
-    }
-    // Reconnect if not Okay
-    if (!connected_) {
-      // Establishing socket connection may take time
-      if (!Connect()) {
-        continue;
-      }
-      LOG_DEBUG("socket connected");
-    }
-
-    // Try to write
-    size_t sentSize = socket_.writeall(packet);
-    if (packet.size() == sentSize) {
-      LOG_DEBUG("send successful");
-      Disconnect();
-      LOG_DEBUG("socket disconnected");
-      return true;
-    }
-
-    LOG_WARN("send failed, retrying %lu ...", retryCount);
-    // Retry to connect and/or send
-  }
-
-  LOG_ERROR("send failed!");
-  return false;
-}
-
-/**
- * @brief Establish connection to FluentD
- * @return true if connected successfully.
- */
-bool FluentdExporter::Connect() {
-  if (!connected_) {
-    socket_ = SocketTools::Socket(socketparams_);
-    connected_ = socket_.connect(*addr_);
-    if (!connected_) {
-      LOG_ERROR("Unable to connect to %s", options_.endpoint.c_str());
-      // Close the socket to avoid leaking file descriptors on failure.
-      if (!socket_.invalid()) {
-        socket_.close();
-      }
-      return false;
-    }
-  }
-  // Connected or already connected
-  return true;
-}
-
-/**
- * @brief Disconnect FluentD socket or datagram.
- * @return
- */
-bool FluentdExporter::Disconnect() {
-  if (connected_) {
-    connected_ = false;
-    if (!socket_.invalid()) {
-      socket_.close();
-      return true;
-    }
+  if (endpoints_ == nullptr) {
+    LOG_ERROR("send failed, exporter is not initialized!");
+    return false;
   }
-  return false;
+  return endpoints_->Send(packet);
 }
 
 /**
- * @brief Initialize FluentD exporter socket.
+ * @brief Initialize FluentD exporter endpoints.
  * @return true if end-point settings have been accepted.
  */
 bool FluentdExporter::Initialize() {
-  UrlParser url(options_.endpoint);
-  bool is_unix_domain = false;
-
-  if (url.scheme_ == kTCP) {
-    socketparams_ = {AF_INET, SOCK_STREAM, 0};
-  } else if (url.scheme_ == kUDP) {
-    socketparams_ = {AF_INET, SOCK_DGRAM, 0};
-  }
-#ifdef HAVE_UNIX_DOMAIN
-  else if (url.scheme_ == kUNIX) {
-    socketparams_ = {AF_UNIX, SOCK_STREAM, 0};
-    is_unix_domain = true;
-  }
-#endif
-  else {
-#if defined(__EXCEPTIONS)
-    // Customers MUST specify valid end-point configuration
-    throw std::runtime_error("Invalid endpoint!");
-#endif
+  endpoints_.reset(new fluentd_common::FluentdEndpointPool(options_));
+  if (endpoints_->size() == 0) {
+    LOG_ERROR("No valid endpoint configured!");
     return false;
   }
-  addr_.reset(
-      new SocketTools::SocketAddr(options_.endpoint.c_str(), is_unix_domain));
-  if (addr_->m_data_in.sin_family != AF_UNIX &&
-      addr_->m_data_in.sin_family != AF_INET &&
-      addr_->m_data_in.sin_family != AF_INET6)
-  {
-    LOG_ERROR("Invalid endpoint! %s", options_.endpoint.c_str());
-    return false;
-  }
-
-  LOG_TRACE("connecting to %s", addr_->toString().c_str());
-
   return true;
 }
 
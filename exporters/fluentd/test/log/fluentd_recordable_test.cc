@@ -80,19 +80,24 @@ struct TestServer {
       std::vector<uint8_t> msg(conn.request_buffer.data(),
                                conn.request_buffer.data() +
                                    conn.request_buffer.size());
+      // The exporter keeps its connection open, several packets may arrive
+      // in one read. They are encoded by nlohmann::json, so re-encoding a
+      // packet gives its size.
+      size_t offset = 0;
       try {
-        auto j = nlohmann::json::from_msgpack(msg);
-        std::cout << "[" << count.fetch_add(1)
-                  << "] SocketServer received payload: " << std::endl
-                  << j.dump(2) << std::endl;
-
-        conn.response_buffer = j.dump(2);
-        conn.state.insert(SocketServer::Connection::Responding);
+        while (offset < msg.size()) {
+          auto j = nlohmann::json::from_msgpack(msg.begin() + offset,
+                                                msg.end(), false);
+          offset += nlohmann::json::to_msgpack(j).size();
+          std::cout << "[" << count.fetch_add(1)
+                    << "] SocketServer received payload: " << std::endl
+                    << j.dump(2) << std::endl;
+        }
         conn.request_buffer.clear();
       } catch (std::exception &) {
-        conn.state.insert(SocketServer::Connection::Receiving);
         // skip invalid payload
       }
+      conn.state.insert(SocketServer::Connection::Receiving);
     };
   }
 
@@ -161,3 +166,65 @@ TEST(FluentdExporter, SendLogEvents) {
   testServer.WaitForEvents(2, 200); // 2 batches must arrive in 200ms
   testServer.Stop();
 }
+
+TEST(FluentdExporter, SendLogEventsWithFailover) {
+  // Start test server on the second endpoint only
+  SocketAddr destination("127.0.0.1:24224");
+  SocketParams params{AF_INET, SOCK_STREAM, 0};
+  SocketServer socketServer(destination, params);
+  TestServer testServer(socketServer);
+  testServer.Start();
+
+  yield_for(std::chrono::milliseconds(500));
+
+  // First endpoint has no listener and must fail over to the second one
+  opentelemetry::exporter::fluentd::common::FluentdExporterOptions options;
+  options.endpoints = {"tcp://127.0.0.1:24223", "tcp://127.0.0.1:24224"};
+  options.tag = "tag.my_service";
+  options.retry_count = 3;
+  options.retry_backoff_initial = std::chrono::milliseconds(1000);
+
+  opentelemetry::exporter::fluentd::common::FluentdEndpointPool pool(options);
+  ASSERT_EQ(pool.size(), 2u);
+
+  std::vector<uint8_t> packet =
+      json::to_msgpack(json::array({options.tag, 0, json::object()}));
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 2; i++) {
+    EXPECT_TRUE(pool.Send(packet));
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // The failed node backs off, the second batch goes straight to the healthy
+  // node without waiting for the backoff.
+  EXPECT_FALSE(pool.IsHealthy(0));
+  EXPECT_TRUE(pool.IsHealthy(1));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+
+  testServer.WaitForEvents(2, 200); // both batches reach the healthy node
+  testServer.Stop();
+}
+
+TEST(FluentdExporter, SendLogEventsWithoutHealthyEndpoint) {
+  // No listener at all: every attempt fails and the node keeps backing off
+  opentelemetry::exporter::fluentd::common::FluentdExporterOptions options;
+  options.endpoint = "tcp://127.0.0.1:24225";
+  options.tag = "tag.my_service";
+  options.retry_count = 3;
+  options.retry_backoff_initial = std::chrono::milliseconds(2000);
+
+  opentelemetry::exporter::fluentd::common::FluentdEndpointPool pool(options);
+  ASSERT_EQ(pool.size(), 1u);
+
+  std::vector<uint8_t> packet =
+      json::to_msgpack(json::array({options.tag, 0, json::object()}));
+
+  // Send must not wait for the backoff of the node between attempts
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(pool.Send(packet));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_FALSE(pool.IsHealthy(0));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(1000));
+}
@@ -274,6 +274,32 @@ TEST(FluentdSpanRecordable, DISABLED_SetSingleAtrribute)
   EXPECT_EQ(rec.span(), j_span);
 }
 
+TEST(FluentdAttributeEncoder, PopulateArrays)
+{
+  namespace fluentd_common = opentelemetry::exporter::fluentd::common;
+  json attributes = json::object();
+
+  const uint64_t uint64_arr[] = {1, 18446744073709551615ULL};
+  fluentd_common::PopulateAttribute(attributes, "uint64_arr",
+                                    nostd::span<const uint64_t>(uint64_arr));
+
+  const bool bool_arr[] = {true, false};
+  fluentd_common::PopulateAttribute(attributes, "bool_arr", nostd::span<const bool>(bool_arr));
+
+  // string_view values are not required to be null-terminated
+  const char text[] = "HelloWorld";
+  fluentd_common::PopulateAttribute(attributes, "str", nostd::string_view(text, 5));
+
+  opentelemetry::sdk::common::OwnedAttributeValue owned = std::vector<bool>{false, true};
+  fluentd_common::PopulateOwnedAttribute(attributes, "owned_bool_arr", owned);
+
+  json expected = {{"uint64_arr", {1ULL, 18446744073709551615ULL}},
+                   {"bool_arr", {true, false}},
+                   {"str", "Hello"},
+                   {"owned_bool_arr", {false, true}}};
+  EXPECT_EQ(attributes, expected);
+}
+
 // Test non-int array types. Int array types are tested using templates (see IntAttributeTest)
 TEST(FluentdSpanRecordable, DISABLED_SetArrayAtrribute)
 {
@@ -360,20 +386,24 @@ struct TestServer {
       std::vector<uint8_t> msg(conn.request_buffer.data(),
                                conn.request_buffer.data() +
                                    conn.request_buffer.size());
-
+      // The exporter keeps its connection open, several packets may arrive
+      // in one read. They are encoded by nlohmann::json, so re-encoding a
+      // packet gives its size.
+      size_t offset = 0;
       try {
-        auto j = nlohmann::json::from_msgpack(msg);
-        std::cout << "[" << count.fetch_add(1)
-                  << "] SocketServer received payload: " << std::endl
-                  << j.dump(2) << std::endl;
-
-        conn.response_buffer = j.dump(2);
-        conn.state.insert(SocketServer::Connection::Responding);
+        while (offset < msg.size()) {
+          auto j = nlohmann::json::from_msgpack(msg.begin() + offset,
+                                                msg.end(), false);
+          offset += nlohmann::json::to_msgpack(j).size();
+          std::cout << "[" << count.fetch_add(1)
+                    << "] SocketServer received payload: " << std::endl
+                    << j.dump(2) << std::endl;
+        }
         conn.request_buffer.clear();
       } catch (std::exception &) {
-        conn.state.insert(SocketServer::Connection::Receiving);
         // skip invalid payload
       }
+      conn.state.insert(SocketServer::Connection::Receiving);
     };
   }
 
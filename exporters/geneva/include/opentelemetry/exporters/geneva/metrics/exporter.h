@@ -5,6 +5,7 @@
 
 #include "opentelemetry/common/spin_lock_mutex.h"
 #include "opentelemetry/common/timestamp.h"
+#include "opentelemetry/exporters/encoding/attribute_encoder.h"
 #include "opentelemetry/exporters/geneva/metrics/connection_string_parser.h"
 #include "opentelemetry/exporters/geneva/metrics/data_transport.h"
 #include "opentelemetry/exporters/geneva/metrics/exporter_options.h"
@@ -119,27 +120,45 @@ static bool SerializeString(char *buffer, size_t &index,
   return true;
 }
 
-static std::string AttributeValueToString(
-    const opentelemetry::sdk::common::OwnedAttributeValue &value) {
-  std::string result;
-  if (nostd::holds_alternative<bool>(value)) {
-    result = nostd::get<bool>(value) ? "true" : "false";
-  } else if (nostd::holds_alternative<int>(value)) {
-    result = std::to_string(nostd::get<int>(value));
-  } else if (nostd::holds_alternative<int64_t>(value)) {
-    result = std::to_string(nostd::get<int64_t>(value));
-  } else if (nostd::holds_alternative<unsigned int>(value)) {
-    result = std::to_string(nostd::get<unsigned int>(value));
-  } else if (nostd::holds_alternative<uint64_t>(value)) {
-    result = std::to_string(nostd::get<uint64_t>(value));
-  } else if (nostd::holds_alternative<double>(value)) {
-    result = std::to_string(nostd::get<double>(value));
-  } else if (nostd::holds_alternative<std::string>(value)) {
-    result = nostd::get<std::string>(value);
-  } else {
+/**
+ * Attribute sink rendering a scalar attribute as a dimension value. Arrays are
+ * not supported as dimensions and are ignored.
+ */
+class DimensionValueSink {
+public:
+  explicit DimensionValueSink(std::string &result) noexcept : result_(result) {}
+
+  void AddScalar(nostd::string_view, bool value) {
+    result_ = value ? "true" : "false";
+  }
+
+  template <class T> void AddScalar(nostd::string_view, T value) {
+    result_ = std::to_string(value);
+  }
+
+  void AddString(nostd::string_view, nostd::string_view value) {
+    result_.assign(value.data(), value.size());
+  }
+
+  template <class It> void AddArray(nostd::string_view, It, It) {
     LOG_WARN("[Geneva Metrics Exporter] AttributeValueToString - "
              " Nested attributes not supported - ignored");
   }
+
+  template <class T>
+  void AddStringArray(nostd::string_view key, const T *first, const T *last) {
+    AddArray(key, first, last);
+  }
+
+private:
+  std::string &result_;
+};
+
+static std::string AttributeValueToString(
+    const opentelemetry::sdk::common::OwnedAttributeValue &value) {
+  std::string result;
+  DimensionValueSink sink(result);
+  encoding::EncodeAttribute(sink, "", value);
   return result;
 }
 
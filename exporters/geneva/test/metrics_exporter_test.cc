@@ -399,6 +399,18 @@ TEST(GenevaExporterTest, GetAggregationTemporalityTest) {
             AggregationTemporality::kDelta);
 }
 
+TEST(GenevaExporterTest, AttributeValueToString) {
+  using opentelemetry::sdk::common::OwnedAttributeValue;
+
+  EXPECT_EQ(AttributeValueToString(OwnedAttributeValue{true}), "true");
+  EXPECT_EQ(AttributeValueToString(OwnedAttributeValue{int32_t{-7}}), "-7");
+  EXPECT_EQ(AttributeValueToString(OwnedAttributeValue{uint64_t{18446744073709551615ULL}}),
+            "18446744073709551615");
+  EXPECT_EQ(AttributeValueToString(OwnedAttributeValue{std::string{"value"}}), "value");
+  // Arrays are not supported as dimension values.
+  EXPECT_EQ(AttributeValueToString(OwnedAttributeValue{std::vector<int64_t>{1, 2}}), "");
+}
+
 // Builds a ResourceMetrics carrying a single Sum (long) point whose attributes
 // are supplied by the caller. Used by the buffer-overflow regression tests.
 static inline opentelemetry::sdk::metrics::ResourceMetrics
@@ -0,0 +1,85 @@
+// Copyright 2023, OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "prometheus/labels.h"
+#include "prometheus/metric_family.h"
+
+#include "opentelemetry/exporters/prometheus/push_exporter_options.h"
+#include "opentelemetry/version.h"
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace metrics
+{
+
+/**
+ * HTTP client of a pushgateway grouping key.
+ *
+ * Unlike ::prometheus::Gateway, the request body may be encoded in the
+ * protobuf delimited format and gzip compressed. The curl handle and the
+ * serialization buffers are kept between pushes, so connections are reused
+ * and steady-state protobuf pushes do not allocate; the text format is
+ * serialized through a std::ostringstream.
+ */
+class PrometheusPushClient
+{
+public:
+  /**
+   * @param options: gateway address, credentials and request encoding
+   * @param labels: sanitized labels of the grouping key
+   */
+  PrometheusPushClient(const PrometheusPushExporterOptions &options,
+                       const ::prometheus::Labels &labels);
+
+  ~PrometheusPushClient();
+
+  PrometheusPushClient(const PrometheusPushClient &)            = delete;
+  PrometheusPushClient &operator=(const PrometheusPushClient &) = delete;
+
+  /**
+   * Send the families to the gateway, replacing the grouping key with
+   * PrometheusPushMethod::kPush or merging into it with kPushAdd.
+   * @param body_size: if not null, set to the size of the request body
+   * @return the HTTP status code, or a negative value if no response was received
+   */
+  int Push(const std::vector<::prometheus::MetricFamily> &families,
+           std::size_t *body_size = nullptr);
+
+  /**
+   * URL of the grouping key.
+   */
+  const std::string &GetUrl() const noexcept { return url_; }
+
+  /**
+   * Append the families to out in the given format.
+   */
+  static void Serialize(const std::vector<::prometheus::MetricFamily> &families,
+                        PrometheusPushFormat format,
+                        std::string &out);
+
+  /**
+   * Replace out with the gzip compression of in.
+   * @return false if zlib failed
+   */
+  static bool Compress(const std::string &in, std::string &out);
+
+private:
+  const PrometheusPushExporterOptions options_;
+  std::string url_;
+
+  std::mutex lock_;
+  void *curl_ = nullptr;
+  std::string body_;
+  std::string compressed_body_;
+};
+
+}  // namespace metrics
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
@@ -18,13 +18,14 @@
 #  include <unistd.h>  // NOLINT
 #endif
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
-#include "prometheus/gateway.h"
-
 #include "opentelemetry/exporters/prometheus/exporter_utils.h"
 #include "opentelemetry/exporters/prometheus/push_exporter_options.h"
 #include "opentelemetry/nostd/span.h"
@@ -40,6 +41,46 @@ namespace metrics
 {
 
 class PrometheusPushCollector;
+class PrometheusPushShards;
+class PrometheusPushStatisticsRecorder;
+class PrometheusPushWorker;
+
+/**
+ * Counters of the pushes made by a PrometheusPushExporter.
+ */
+struct PrometheusPushStatistics
+{
+  /**
+   * Upper bounds, in milliseconds, of the push latency histogram buckets. The
+   * last bucket of latency_buckets counts the slower pushes.
+   */
+  static constexpr std::array<double, 11> kLatencyBoundariesMs = {
+      {1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000}};
+
+  std::uint64_t pushes        = 0;
+  std::uint64_t failed_pushes = 0;
+  // Exports rejected because the collection was full.
+  std::uint64_t dropped_exports = 0;
+
+  // Metrics translated with the names interned by a previous export, and
+  // metrics whose names had to be sanitized.
+  std::uint64_t interned_metrics   = 0;
+  std::uint64_t translated_metrics = 0;
+
+  std::uint64_t payload_bytes      = 0;
+  std::uint64_t last_payload_bytes = 0;
+  std::uint64_t series             = 0;
+  std::uint64_t last_series        = 0;
+
+  std::chrono::microseconds push_latency{0};
+  std::chrono::microseconds last_push_latency{0};
+  std::chrono::microseconds max_push_latency{0};
+  std::array<std::uint64_t, kLatencyBoundariesMs.size() + 1> latency_buckets{};
+
+  // Responses by HTTP status code. Transport errors, without any response,
+  // are counted under the negated curl error code.
+  std::map<int, std::uint64_t> http_status;
+};
 
 class PrometheusPushExporter : public ::opentelemetry::sdk::metrics::PushMetricExporter
 {
@@ -51,6 +92,10 @@ class PrometheusPushExporter : public ::opentelemetry::sdk::metrics::PushMetricE
    */
   explicit PrometheusPushExporter(const PrometheusPushExporterOptions &options);
 
+  PrometheusPushExporter(PrometheusPushExporter &&other);
+
+  ~PrometheusPushExporter() override;
+
   /**
    * Get the AggregationTemporality for Prometheus exporter
    *
@@ -68,7 +113,9 @@ class PrometheusPushExporter : public ::opentelemetry::sdk::metrics::PushMetricE
       const ::opentelemetry::sdk::metrics::ResourceMetrics &data) noexcept override;
 
   /**
-   * Force flush the exporter.
+   * Force flush the exporter: push the metrics that are still pending and wait for the push to
+   * complete.
+   * @return false on timeout, or if the last push was not accepted by every gateway
    */
   bool ForceFlush(
       std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override;
@@ -94,6 +141,11 @@ class PrometheusPushExporter : public ::opentelemetry::sdk::metrics::PushMetricE
    */
   bool IsShutdown() const;
 
+  /**
+   * @return: a snapshot of the push counters
+   */
+  PrometheusPushStatistics GetStatistics() const;
+
 private:
   // The configuration options associated with this exporter.
   const PrometheusPushExporterOptions options_;
@@ -109,10 +161,20 @@ class PrometheusPushExporter : public ::opentelemetry::sdk::metrics::PushMetricE
   std::shared_ptr<PrometheusPushCollector> collector_;
 
   /**
-   * Pointer to an
-   * Gateway instance
+   * Gateways the metric families are pushed to
+   */
+  std::unique_ptr<PrometheusPushShards> shards_;
+
+  /**
+   * Push counters
+   */
+  std::unique_ptr<PrometheusPushStatisticsRecorder> statistics_;
+
+  /**
+   * Background push thread, only used with
+   * PrometheusPushExporterOptions::async_push
    */
-  std::unique_ptr<::prometheus::Gateway> gateway_;
+  std::unique_ptr<PrometheusPushWorker> push_worker_;
 
   /**
    * friend class for testing
@@ -3,9 +3,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "opentelemetry/version.h"
 
@@ -15,6 +17,40 @@ namespace exporter
 namespace metrics
 {
 
+/**
+ * Encoding of the pushed metrics.
+ */
+enum class PrometheusPushFormat
+{
+  // Text exposition format.
+  kText,
+  // Protobuf delimited MetricFamily messages, smaller and cheaper to serialize.
+  kProtobuf
+};
+
+/**
+ * How pushed metrics are merged with the ones already held by the gateway.
+ */
+enum class PrometheusPushMethod
+{
+  // PUT: replace every metric of the grouping key.
+  kPush,
+  // POST: only replace the metrics with the same name.
+  kPushAdd
+};
+
+/**
+ * Pushgateway endpoint, or grouping key, of a shard.
+ */
+struct PrometheusPushGateway
+{
+  // Empty host or port default to the ones of PrometheusPushExporterOptions.
+  std::string host;
+  std::string port;
+  // Grouping key labels, added to PrometheusPushExporterOptions::labels.
+  std::unordered_map<std::string, std::string> labels;
+};
+
 /**
  * Struct to hold Prometheus exporter options.
  */
@@ -27,8 +63,34 @@ struct PrometheusPushExporterOptions
   std::string username;
   std::string password;
 
+  // Maximum number of metric families waiting to be pushed. Families exported again before
+  // they are pushed replace the pending ones and do not count twice.
   std::size_t max_collection_size = 2000;
 
+  // Push from a background thread. Export then only translates and queues the metrics and
+  // returns without waiting for the pushgateway; push failures are reported in the logs only.
+  bool async_push = false;
+
+  PrometheusPushFormat format = PrometheusPushFormat::kText;
+
+  PrometheusPushMethod method = PrometheusPushMethod::kPush;
+
+  // Compress request bodies with gzip.
+  bool gzip_compression = false;
+
+  // Maximum duration of a push request, connection included. Zero keeps the curl defaults.
+  std::chrono::milliseconds push_timeout{10000};
+
+  // Add the exporter's own counters to every push, as the
+  // otel_prometheus_push_* families.
+  bool export_self_metrics = false;
+
+  // Spread metric families over several gateways or grouping keys, pushed in
+  // parallel. Families are assigned by consistent hashing of their name, so a
+  // family stays on the same shard across pushes. Shards must differ by
+  // address or labels. When empty, everything is pushed to host:port.
+  std::vector<PrometheusPushGateway> shards;
+
   inline PrometheusPushExporterOptions() noexcept {}
 };
 
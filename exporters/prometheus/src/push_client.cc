@@ -0,0 +1,478 @@
+// Copyright 2023, OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include "opentelemetry/exporters/prometheus/push_client.h"
+
+#include <curl/curl.h>
+#include <zlib.h>
+
+#include <prometheus/text_serializer.h>
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+#include "opentelemetry/sdk/common/global_log_handler.h"
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+
+namespace exporter
+{
+namespace metrics
+{
+
+namespace
+{
+
+constexpr const char *kTextContentType = "Content-Type: text/plain; version=0.0.4; charset=utf-8";
+constexpr const char *kProtobufContentType =
+    "Content-Type: application/vnd.google.protobuf; proto=io.prometheus.client.MetricFamily; "
+    "encoding=delimited";
+
+/**
+ * Wire types and field numbers of io.prometheus.client metrics.proto.
+ */
+enum WireType : uint32_t
+{
+  kVarint          = 0,
+  kFixed64         = 1,
+  kLengthDelimited = 2
+};
+
+enum ProtoMetricType : uint64_t
+{
+  kProtoCounter   = 0,
+  kProtoGauge     = 1,
+  kProtoSummary   = 2,
+  kProtoUntyped   = 3,
+  kProtoHistogram = 4
+};
+
+inline std::size_t VarintSize(uint64_t value)
+{
+  std::size_t size = 1;
+  while (value >= 0x80)
+  {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+inline std::size_t TagSize(uint32_t field)
+{
+  return VarintSize(field << 3);
+}
+
+inline std::size_t StringFieldSize(uint32_t field, const std::string &value)
+{
+  return TagSize(field) + VarintSize(value.size()) + value.size();
+}
+
+inline std::size_t DoubleFieldSize(uint32_t field)
+{
+  return TagSize(field) + sizeof(double);
+}
+
+inline std::size_t VarintFieldSize(uint32_t field, uint64_t value)
+{
+  return TagSize(field) + VarintSize(value);
+}
+
+inline std::size_t MessageFieldSize(uint32_t field, std::size_t size)
+{
+  return TagSize(field) + VarintSize(size) + size;
+}
+
+inline void WriteVarint(uint64_t value, std::string &out)
+{
+  while (value >= 0x80)
+  {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline void WriteTag(uint32_t field, WireType type, std::string &out)
+{
+  WriteVarint((field << 3) | type, out);
+}
+
+inline void WriteString(uint32_t field, const std::string &value, std::string &out)
+{
+  WriteTag(field, kLengthDelimited, out);
+  WriteVarint(value.size(), out);
+  out.append(value);
+}
+
+inline void WriteDouble(uint32_t field, double value, std::string &out)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  WriteTag(field, kFixed64, out);
+  for (std::size_t i = 0; i < sizeof(bits); ++i)
+  {
+    out.push_back(static_cast<char>(bits >> (8 * i)));
+  }
+}
+
+inline void WriteVarintField(uint32_t field, uint64_t value, std::string &out)
+{
+  WriteTag(field, kVarint, out);
+  WriteVarint(value, out);
+}
+
+inline void WriteMessageHeader(uint32_t field, std::size_t size, std::string &out)
+{
+  WriteTag(field, kLengthDelimited, out);
+  WriteVarint(size, out);
+}
+
+ProtoMetricType ToProtoType(::prometheus::MetricType type)
+{
+  switch (type)
+  {
+    case ::prometheus::MetricType::Counter:
+      return kProtoCounter;
+    case ::prometheus::MetricType::Gauge:
+      return kProtoGauge;
+    case ::prometheus::MetricType::Summary:
+      return kProtoSummary;
+    case ::prometheus::MetricType::Histogram:
+      return kProtoHistogram;
+    case ::prometheus::MetricType::Info:
+      // Info metrics are exposed as gauges of value 1.
+      return kProtoGauge;
+    default:
+      return kProtoUntyped;
+  }
+}
+
+double GaugeValue(::prometheus::MetricType type, const ::prometheus::ClientMetric &metric)
+{
+  return type == ::prometheus::MetricType::Info ? 1.0 : metric.gauge.value;
+}
+
+// message LabelPair { string name = 1; string value = 2; }
+std::size_t LabelSize(const ::prometheus::ClientMetric::Label &label)
+{
+  return StringFieldSize(1, label.name) + StringFieldSize(2, label.value);
+}
+
+// message Summary { uint64 sample_count = 1; double sample_sum = 2; repeated Quantile quantile = 3; }
+// message Quantile { double quantile = 1; double value = 2; }
+std::size_t SummarySize(const ::prometheus::ClientMetric::Summary &summary)
+{
+  std::size_t size = VarintFieldSize(1, summary.sample_count) + DoubleFieldSize(2);
+  size += summary.quantile.size() * MessageFieldSize(3, 2 * DoubleFieldSize(1));
+  return size;
+}
+
+// message Histogram { uint64 sample_count = 1; double sample_sum = 2; repeated Bucket bucket = 3; }
+// message Bucket { uint64 cumulative_count = 1; double upper_bound = 2; }
+std::size_t BucketSize(const ::prometheus::ClientMetric::Bucket &bucket)
+{
+  return VarintFieldSize(1, bucket.cumulative_count) + DoubleFieldSize(2);
+}
+
+std::size_t HistogramSize(const ::prometheus::ClientMetric::Histogram &histogram)
+{
+  std::size_t size = VarintFieldSize(1, histogram.sample_count) + DoubleFieldSize(2);
+  for (const auto &bucket : histogram.bucket)
+  {
+    size += MessageFieldSize(3, BucketSize(bucket));
+  }
+  return size;
+}
+
+// message Metric { repeated LabelPair label = 1; Gauge gauge = 2; Counter counter = 3;
+//                  Summary summary = 4; Untyped untyped = 5; int64 timestamp_ms = 6;
+//                  Histogram histogram = 7; }
+// Gauge, Counter and Untyped all are { double value = 1; }
+std::size_t ValueSize(ProtoMetricType type, const ::prometheus::ClientMetric &metric)
+{
+  switch (type)
+  {
+    case kProtoSummary:
+      return SummarySize(metric.summary);
+    case kProtoHistogram:
+      return HistogramSize(metric.histogram);
+    default:
+      return DoubleFieldSize(1);
+  }
+}
+
+uint32_t ValueField(ProtoMetricType type)
+{
+  switch (type)
+  {
+    case kProtoGauge:
+      return 2;
+    case kProtoCounter:
+      return 3;
+    case kProtoSummary:
+      return 4;
+    case kProtoHistogram:
+      return 7;
+    default:
+      return 5;
+  }
+}
+
+std::size_t MetricSize(ProtoMetricType type, const ::prometheus::ClientMetric &metric)
+{
+  std::size_t size = 0;
+  for (const auto &label : metric.label)
+  {
+    size += MessageFieldSize(1, LabelSize(label));
+  }
+  size += MessageFieldSize(ValueField(type), ValueSize(type, metric));
+  if (metric.timestamp_ms != 0)
+  {
+    size += VarintFieldSize(6, static_cast<uint64_t>(metric.timestamp_ms));
+  }
+  return size;
+}
+
+void WriteMetric(::prometheus::MetricType family_type,
+                 ProtoMetricType type,
+                 const ::prometheus::ClientMetric &metric,
+                 std::string &out)
+{
+  for (const auto &label : metric.label)
+  {
+    WriteMessageHeader(1, LabelSize(label), out);
+    WriteString(1, label.name, out);
+    WriteString(2, label.value, out);
+  }
+
+  WriteMessageHeader(ValueField(type), ValueSize(type, metric), out);
+  switch (type)
+  {
+    case kProtoGauge:
+      WriteDouble(1, GaugeValue(family_type, metric), out);
+      break;
+    case kProtoCounter:
+      WriteDouble(1, metric.counter.value, out);
+      break;
+    case kProtoSummary:
+      WriteVarintField(1, metric.summary.sample_count, out);
+      WriteDouble(2, metric.summary.sample_sum, out);
+      for (const auto &quantile : metric.summary.quantile)
+      {
+        WriteMessageHeader(3, 2 * DoubleFieldSize(1), out);
+        WriteDouble(1, quantile.quantile, out);
+        WriteDouble(2, quantile.value, out);
+      }
+      break;
+    case kProtoHistogram:
+      WriteVarintField(1, metric.histogram.sample_count, out);
+      WriteDouble(2, metric.histogram.sample_sum, out);
+      for (const auto &bucket : metric.histogram.bucket)
+      {
+        WriteMessageHeader(3, BucketSize(bucket), out);
+        WriteVarintField(1, bucket.cumulative_count, out);
+        WriteDouble(2, bucket.upper_bound, out);
+      }
+      break;
+    default:
+      WriteDouble(1, metric.untyped.value, out);
+      break;
+  }
+
+  if (metric.timestamp_ms != 0)
+  {
+    WriteVarintField(6, static_cast<uint64_t>(metric.timestamp_ms), out);
+  }
+}
+
+// message MetricFamily { string name = 1; string help = 2; MetricType type = 3;
+//                        repeated Metric metric = 4; }
+// Each family is prefixed with its size, as in the delimited format.
+void WriteFamily(const ::prometheus::MetricFamily &family, std::string &out)
+{
+  ProtoMetricType type = ToProtoType(family.type);
+
+  std::size_t size = StringFieldSize(1, family.name) + VarintFieldSize(3, type);
+  if (!family.help.empty())
+  {
+    size += StringFieldSize(2, family.help);
+  }
+  for (const auto &metric : family.metric)
+  {
+    size += MessageFieldSize(4, MetricSize(type, metric));
+  }
+
+  out.reserve(out.size() + VarintSize(size) + size);
+  WriteVarint(size, out);
+  WriteString(1, family.name, out);
+  if (!family.help.empty())
+  {
+    WriteString(2, family.help, out);
+  }
+  WriteVarintField(3, type, out);
+  for (const auto &metric : family.metric)
+  {
+    WriteMessageHeader(4, MetricSize(type, metric), out);
+    WriteMetric(family.type, type, metric, out);
+  }
+}
+
+std::size_t DiscardResponse(char * /*data*/, std::size_t size, std::size_t count, void * /*user*/)
+{
+  return size * count;
+}
+
+// curl_global_init is not thread safe, run it once before the first handle is created.
+void InitializeCurl()
+{
+  static std::once_flag once;
+  std::call_once(once, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+}  // namespace
+
+PrometheusPushClient::PrometheusPushClient(const PrometheusPushExporterOptions &options,
+                                           const ::prometheus::Labels &labels)
+    : options_(options)
+{
+  InitializeCurl();
+
+  // Same grouping key URL as ::prometheus::Gateway.
+  url_ = options_.host + ":" + options_.port + "/metrics/job/" + options_.jobname;
+  for (const auto &label : labels)
+  {
+    url_ += "/" + label.first + "/" + label.second;
+  }
+}
+
+PrometheusPushClient::~PrometheusPushClient()
+{
+  if (curl_ != nullptr)
+  {
+    curl_easy_cleanup(static_cast<CURL *>(curl_));
+  }
+}
+
+void PrometheusPushClient::Serialize(const std::vector<::prometheus::MetricFamily> &families,
+                                     PrometheusPushFormat format,
+                                     std::string &out)
+{
+  if (format == PrometheusPushFormat::kProtobuf)
+  {
+    for (const auto &family : families)
+    {
+      WriteFamily(family, out);
+    }
+    return;
+  }
+
+  std::ostringstream stream;
+  ::prometheus::TextSerializer().Serialize(stream, families);
+  out.append(stream.str());
+}
+
+bool PrometheusPushClient::Compress(const std::string &in, std::string &out)
+{
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  // 15 window bits, +16 for a gzip header instead of a zlib one.
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK)
+  {
+    return false;
+  }
+
+  out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+  stream.next_in   = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+  stream.avail_in  = static_cast<uInt>(in.size());
+  stream.next_out  = reinterpret_cast<Bytef *>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+
+  int result = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
+
+int PrometheusPushClient::Push(const std::vector<::prometheus::MetricFamily> &families,
+                               std::size_t *body_size)
+{
+  std::lock_guard<std::mutex> guard{lock_};
+
+  if (curl_ == nullptr)
+  {
+    curl_ = curl_easy_init();
+    if (curl_ == nullptr)
+    {
+      OTEL_INTERNAL_LOG_ERROR("[Prometheus Push Exporter] Unable to create curl handle");
+      return -1;
+    }
+  }
+  CURL *curl = static_cast<CURL *>(curl_);
+
+  body_.clear();
+  Serialize(families, options_.format, body_);
+
+  const std::string *body = &body_;
+  if (options_.gzip_compression)
+  {
+    if (!Compress(body_, compressed_body_))
+    {
+      OTEL_INTERNAL_LOG_ERROR("[Prometheus Push Exporter] Compressing the request body failed");
+      return -1;
+    }
+    body = &compressed_body_;
+  }
+  if (body_size != nullptr)
+  {
+    *body_size = body->size();
+  }
+
+  curl_slist *headers = curl_slist_append(
+      nullptr,
+      options_.format == PrometheusPushFormat::kProtobuf ? kProtobufContentType : kTextContentType);
+  if (options_.gzip_compression)
+  {
+    headers = curl_slist_append(headers, "Content-Encoding: gzip");
+  }
+
+  // The handle keeps its connection cache, other options are set again for each request.
+  curl_easy_reset(curl);
+  curl_easy_setopt(curl, CURLOPT_URL, url_.c_str());
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->data());
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body->size()));
+  curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST,
+                   options_.method == PrometheusPushMethod::kPush ? "PUT" : "POST");
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardResponse);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(options_.push_timeout.count()));
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+                   static_cast<long>(options_.push_timeout.count()));
+  if (!options_.username.empty())
+  {
+    curl_easy_setopt(curl, CURLOPT_USERNAME, options_.username.c_str());
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, options_.password.c_str());
+  }
+
+  CURLcode result = curl_easy_perform(curl);
+  curl_slist_free_all(headers);
+
+  if (result != CURLE_OK)
+  {
+    OTEL_INTERNAL_LOG_ERROR("[Prometheus Push Exporter] Push to "
+                            << url_ << " failed: " << curl_easy_strerror(result));
+    return -static_cast<int>(result);
+  }
+
+  long response_code = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+  return static_cast<int>(response_code);
+}
+
+}  // namespace metrics
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
@@ -2,13 +2,26 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "opentelemetry/exporters/prometheus/push_exporter.h"
+#include "opentelemetry/exporters/prometheus/push_client.h"
 
 #include <prometheus/labels.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "opentelemetry/sdk/common/attributemap_hash.h"
+#include "opentelemetry/sdk/common/global_log_handler.h"
 
 OPENTELEMETRY_BEGIN_NAMESPACE
 
@@ -19,34 +32,96 @@ namespace metrics
 
 namespace
 {
-static std::string SanitizePrometheusNames(std::string name, bool label)
+/**
+ * Character classes of Prometheus names, see IsSanitizedPrometheusName.
+ */
+enum PrometheusNameClass : uint8_t
 {
-  constexpr const auto replacement     = '_';
-  constexpr const auto replacement_dup = '=';
+  kNameValid      = 0,
+  kNameDigit      = 1,
+  kNameUnderscore = 2,
+  kNameInvalid    = 4
+};
+
+struct PrometheusNameTable
+{
+  uint8_t classes[256];
 
-  bool (*valid)(std::size_t, char);
-  if (label)
+  explicit PrometheusNameTable(bool label)
   {
-    valid = [](std::size_t i, char c) {
-      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9' && i > 0))
+    for (int c = 0; c < 256; ++c)
+    {
+      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (!label && c == ':'))
       {
-        return true;
+        classes[c] = kNameValid;
       }
-      return false;
-    };
-  }
-  else
-  {
-    valid = [](std::size_t i, char c) {
-      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == ':' ||
-          (c >= '0' && c <= '9' && i > 0))
+      else if (c >= '0' && c <= '9')
       {
-        return true;
+        classes[c] = kNameDigit;
       }
-      return false;
-    };
+      else if (c == '_')
+      {
+        classes[c] = kNameUnderscore;
+      }
+      else
+      {
+        classes[c] = kNameInvalid;
+      }
+    }
+  }
+};
+
+const PrometheusNameTable &GetPrometheusNameTable(bool label)
+{
+  static const PrometheusNameTable label_table(true);
+  static const PrometheusNameTable metric_table(false);
+  return label ? label_table : metric_table;
+}
+
+/**
+ * Check whether sanitizing would leave the name unchanged: it has no invalid
+ * character, no leading digit and no consecutive underscores. The loop has no
+ * data dependent branch, so compilers vectorize it.
+ */
+bool IsSanitizedPrometheusName(const std::string &name, bool label)
+{
+  if (name.empty())
+  {
+    return true;
+  }
+
+  const uint8_t *classes = GetPrometheusNameTable(label).classes;
+  const auto *data       = reinterpret_cast<const unsigned char *>(name.data());
+
+  uint8_t invalid         = classes[data[0]] & kNameDigit;
+  uint8_t prev_underscore = classes[data[0]] & kNameUnderscore;
+  invalid |= classes[data[0]] & kNameInvalid;
+  for (std::size_t i = 1; i < name.size(); ++i)
+  {
+    uint8_t current = classes[data[i]];
+    invalid |= current & kNameInvalid;
+    invalid |= prev_underscore & current;
+    prev_underscore = current & kNameUnderscore;
+  }
+  return invalid == 0;
+}
+
+static std::string SanitizePrometheusNames(std::string name, bool label)
+{
+  constexpr const auto replacement     = '_';
+  constexpr const auto replacement_dup = '=';
+
+  if (IsSanitizedPrometheusName(name, label))
+  {
+    return name;
   }
 
+  const uint8_t *classes = GetPrometheusNameTable(label).classes;
+  auto valid             = [classes](std::size_t i, char c) {
+    uint8_t current = classes[static_cast<unsigned char>(c)];
+    return current == kNameValid || (current == kNameDigit && i > 0);
+  };
+
   bool has_dup = false;
   for (std::size_t i = 0; i < name.size(); ++i)
   {
@@ -72,8 +147,393 @@ static std::string SanitizePrometheusNames(std::string name, bool label)
 
   return name;
 }
+
+struct PointAttributesHash
+{
+  std::size_t operator()(const ::opentelemetry::sdk::metrics::PointAttributes &attributes) const
+  {
+    return ::opentelemetry::sdk::common::GetHashForAttributeMap(attributes);
+  }
+};
+
+double ToDouble(const ::opentelemetry::sdk::metrics::ValueType &value)
+{
+  if (nostd::holds_alternative<int64_t>(value))
+  {
+    return static_cast<double>(nostd::get<int64_t>(value));
+  }
+  return nostd::get<double>(value);
+}
+
 }  // namespace
 
+/**
+ * Translation of the exported metrics into metric families, with the sanitized
+ * metric and label names interned across exports. PrometheusExporterUtils
+ * sanitizes every name it translates, so it only translates the exports with a
+ * metric or a series not seen before. The names and labels of its families are
+ * then interned by scope and instrument descriptor name, and the next exports
+ * of the same series only get their values filled in.
+ */
+class PrometheusPushTranslator
+{
+public:
+  std::vector<::prometheus::MetricFamily> Translate(
+      const ::opentelemetry::sdk::metrics::ResourceMetrics &data)
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+
+    std::vector<::prometheus::MetricFamily> families;
+    std::size_t metrics = 0;
+    if (TranslateInterned(data, families, metrics))
+    {
+      interned_metrics_ += metrics;
+      return families;
+    }
+
+    families = PrometheusExporterUtils::TranslateToPrometheus(data);
+    translated_metrics_ += Intern(data, families);
+    return families;
+  }
+
+  /**
+   * Fill the translation counters of the statistics.
+   */
+  void GetStatistics(PrometheusPushStatistics &statistics) const
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+    statistics.interned_metrics   = interned_metrics_;
+    statistics.translated_metrics = translated_metrics_;
+  }
+
+private:
+  // Bounds of the interned names, exports beyond them are translated every time.
+  static constexpr std::size_t kMaxInternedSeries = 16384;
+
+  struct InternedSeries
+  {
+    std::vector<::prometheus::ClientMetric::Label> labels;
+    std::vector<double> upper_bounds;
+  };
+
+  struct InternedMetric
+  {
+    ::opentelemetry::sdk::metrics::InstrumentDescriptor descriptor;
+    bool monotonic = true;
+    bool timestamp = false;
+    // Name, help and type of the family, without any metric.
+    ::prometheus::MetricFamily family;
+    std::unordered_map<::opentelemetry::sdk::metrics::PointAttributes,
+                       InternedSeries,
+                       PointAttributesHash>
+        series;
+  };
+
+  static std::string Key(
+      const ::opentelemetry::sdk::instrumentationscope::InstrumentationScope *scope,
+      const std::string &name)
+  {
+    std::string key;
+    if (scope != nullptr)
+    {
+      key += scope->GetName();
+      key += '\0';
+      key += scope->GetVersion();
+    }
+    key += '\0';
+    key += name;
+    return key;
+  }
+
+  static bool SameDescriptor(const ::opentelemetry::sdk::metrics::InstrumentDescriptor &a,
+                             const ::opentelemetry::sdk::metrics::InstrumentDescriptor &b)
+  {
+    return a.name_ == b.name_ && a.description_ == b.description_ && a.unit_ == b.unit_ &&
+           a.type_ == b.type_ && a.value_type_ == b.value_type_;
+  }
+
+  static std::int64_t TimestampMs(const ::opentelemetry::sdk::metrics::MetricData &metric_data)
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               metric_data.end_ts.time_since_epoch())
+        .count();
+  }
+
+  /**
+   * Fill the value of a series, as PrometheusExporterUtils does.
+   * @return false if the point does not match the interned family
+   */
+  static bool FillValue(const InternedMetric &interned,
+                        const InternedSeries &series,
+                        const ::opentelemetry::sdk::metrics::PointType &point,
+                        ::prometheus::ClientMetric &metric)
+  {
+    namespace metric_sdk = ::opentelemetry::sdk::metrics;
+
+    const metric_sdk::ValueType *value = nullptr;
+    if (nostd::holds_alternative<metric_sdk::SumPointData>(point))
+    {
+      const auto &sum = nostd::get<metric_sdk::SumPointData>(point);
+      if (sum.is_monotonic_ != interned.monotonic)
+      {
+        return false;
+      }
+      value = &sum.value_;
+    }
+    else if (nostd::holds_alternative<metric_sdk::LastValuePointData>(point))
+    {
+      value = &nostd::get<metric_sdk::LastValuePointData>(point).value_;
+    }
+
+    switch (interned.family.type)
+    {
+      case ::prometheus::MetricType::Counter:
+        if (value == nullptr)
+        {
+          return false;
+        }
+        metric.counter.value = ToDouble(*value);
+        return true;
+      case ::prometheus::MetricType::Gauge:
+        if (value == nullptr)
+        {
+          return false;
+        }
+        metric.gauge.value = ToDouble(*value);
+        return true;
+      case ::prometheus::MetricType::Untyped:
+        if (value == nullptr)
+        {
+          return false;
+        }
+        metric.untyped.value = ToDouble(*value);
+        return true;
+      case ::prometheus::MetricType::Histogram: {
+        if (!nostd::holds_alternative<metric_sdk::HistogramPointData>(point))
+        {
+          return false;
+        }
+        const auto &histogram = nostd::get<metric_sdk::HistogramPointData>(point);
+        if (histogram.boundaries_ != series.upper_bounds ||
+            histogram.counts_.size() != histogram.boundaries_.size() + 1)
+        {
+          return false;
+        }
+        metric.histogram.sample_count = histogram.count_;
+        metric.histogram.sample_sum   = ToDouble(histogram.sum_);
+        metric.histogram.bucket.resize(histogram.counts_.size());
+        std::uint64_t cumulative_count = 0;
+        for (std::size_t i = 0; i < histogram.counts_.size(); ++i)
+        {
+          cumulative_count += histogram.counts_[i];
+          metric.histogram.bucket[i].cumulative_count = cumulative_count;
+          metric.histogram.bucket[i].upper_bound      = i < histogram.boundaries_.size()
+                                                            ? histogram.boundaries_[i]
+                                                            : std::numeric_limits<double>::infinity();
+        }
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  /**
+   * Build the families from the interned names only.
+   * @return false if a metric or a series was not interned yet
+   */
+  bool TranslateInterned(const ::opentelemetry::sdk::metrics::ResourceMetrics &data,
+                         std::vector<::prometheus::MetricFamily> &families,
+                         std::size_t &metrics) const
+  {
+    if (data.scope_metric_data_.empty() || !target_interned_ || data.resource_ != target_resource_)
+    {
+      return false;
+    }
+
+    const auto &first_scope = data.scope_metric_data_.front();
+    if (first_scope.metric_data_.empty() || first_scope.scope_ != target_scope_)
+    {
+      return false;
+    }
+
+    families.reserve(1 + first_scope.metric_data_.size());
+    if (has_target_info_)
+    {
+      families.push_back(target_info_);
+      if (target_info_timestamp_)
+      {
+        for (auto &metric : families.back().metric)
+        {
+          metric.timestamp_ms = TimestampMs(first_scope.metric_data_.front());
+        }
+      }
+    }
+
+    for (const auto &scope_metrics : data.scope_metric_data_)
+    {
+      for (const auto &metric_data : scope_metrics.metric_data_)
+      {
+        if (metric_data.point_data_attr_.empty())
+        {
+          continue;
+        }
+
+        auto found =
+            metrics_.find(Key(scope_metrics.scope_, metric_data.instrument_descriptor.name_));
+        if (found == metrics_.end() ||
+            !SameDescriptor(found->second.descriptor, metric_data.instrument_descriptor))
+        {
+          return false;
+        }
+        const InternedMetric &interned = found->second;
+
+        families.push_back(interned.family);
+        auto &family = families.back();
+        family.metric.resize(metric_data.point_data_attr_.size());
+        for (std::size_t i = 0; i < metric_data.point_data_attr_.size(); ++i)
+        {
+          const auto &point = metric_data.point_data_attr_[i];
+          auto series       = interned.series.find(point.attributes);
+          if (series == interned.series.end() ||
+              !FillValue(interned, series->second, point.point_data, family.metric[i]))
+          {
+            return false;
+          }
+          family.metric[i].label = series->second.labels;
+          if (interned.timestamp)
+          {
+            family.metric[i].timestamp_ms = TimestampMs(metric_data);
+          }
+        }
+        ++metrics;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Intern the names and labels of the families PrometheusExporterUtils
+   * translated from the metrics.
+   * @return the number of translated metrics
+   */
+  std::size_t Intern(const ::opentelemetry::sdk::metrics::ResourceMetrics &data,
+                     const std::vector<::prometheus::MetricFamily> &families)
+  {
+    namespace metric_sdk = ::opentelemetry::sdk::metrics;
+
+    std::size_t metrics = 0;
+    for (const auto &scope_metrics : data.scope_metric_data_)
+    {
+      for (const auto &metric_data : scope_metrics.metric_data_)
+      {
+        if (!metric_data.point_data_attr_.empty())
+        {
+          ++metrics;
+        }
+      }
+    }
+
+    // Families are translated in the order of the metrics, after target_info if any.
+    bool has_target_info = families.size() == metrics + 1 && families.front().name == "target_info";
+    if (data.scope_metric_data_.empty() || data.scope_metric_data_.front().metric_data_.empty() ||
+        (families.size() != metrics && !has_target_info))
+    {
+      return metrics;
+    }
+
+    target_resource_ = data.resource_;
+    target_scope_    = data.scope_metric_data_.front().scope_;
+    has_target_info_ = has_target_info;
+    if (has_target_info)
+    {
+      target_info_ = families.front();
+      target_info_timestamp_ =
+          !target_info_.metric.empty() && target_info_.metric.front().timestamp_ms != 0;
+    }
+    target_interned_ = true;
+
+    std::size_t index = has_target_info ? 1 : 0;
+    for (const auto &scope_metrics : data.scope_metric_data_)
+    {
+      for (const auto &metric_data : scope_metrics.metric_data_)
+      {
+        if (metric_data.point_data_attr_.empty())
+        {
+          continue;
+        }
+
+        const auto &family = families[index++];
+        if (family.metric.size() != metric_data.point_data_attr_.size())
+        {
+          continue;
+        }
+
+        auto key   = Key(scope_metrics.scope_, metric_data.instrument_descriptor.name_);
+        auto found = metrics_.find(key);
+        if (found != metrics_.end() &&
+            !SameDescriptor(found->second.descriptor, metric_data.instrument_descriptor))
+        {
+          interned_series_ -= found->second.series.size();
+          metrics_.erase(found);
+          found = metrics_.end();
+        }
+        if (found == metrics_.end())
+        {
+          InternedMetric interned;
+          interned.descriptor  = metric_data.instrument_descriptor;
+          interned.family.name = family.name;
+          interned.family.help = family.help;
+          interned.family.type = family.type;
+          interned.timestamp   = family.metric.front().timestamp_ms != 0;
+          const auto &front    = metric_data.point_data_attr_.front().point_data;
+          if (nostd::holds_alternative<metric_sdk::SumPointData>(front))
+          {
+            interned.monotonic = nostd::get<metric_sdk::SumPointData>(front).is_monotonic_;
+          }
+          found = metrics_.emplace(std::move(key), std::move(interned)).first;
+        }
+
+        for (std::size_t i = 0; i < metric_data.point_data_attr_.size(); ++i)
+        {
+          if (interned_series_ >= kMaxInternedSeries)
+          {
+            break;
+          }
+          const auto &point = metric_data.point_data_attr_[i];
+          InternedSeries series;
+          series.labels = family.metric[i].label;
+          if (nostd::holds_alternative<metric_sdk::HistogramPointData>(point.point_data))
+          {
+            series.upper_bounds =
+                nostd::get<metric_sdk::HistogramPointData>(point.point_data).boundaries_;
+          }
+          if (found->second.series.emplace(point.attributes, std::move(series)).second)
+          {
+            ++interned_series_;
+          }
+        }
+      }
+    }
+    return metrics;
+  }
+
+  mutable std::mutex lock_;
+
+  const ::opentelemetry::sdk::resource::Resource *target_resource_                    = nullptr;
+  const ::opentelemetry::sdk::instrumentationscope::InstrumentationScope *target_scope_ = nullptr;
+  ::prometheus::MetricFamily target_info_;
+  bool target_info_timestamp_ = false;
+  bool has_target_info_       = false;
+  bool target_interned_       = false;
+
+  std::unordered_map<std::string, InternedMetric> metrics_;
+  std::size_t interned_series_ = 0;
+
+  std::uint64_t interned_metrics_   = 0;
+  std::uint64_t translated_metrics_ = 0;
+};
+
 class PrometheusPushCollector : public ::prometheus::Collectable
 {
 public:
@@ -92,48 +552,89 @@ class PrometheusPushCollector : public ::prometheus::Collectable
   /**
    * Collects all metrics data from metricsToCollect collection.
    *
+   * The pending collection is swapped out, so exports keep filling a fresh buffer while the
+   * collected one is being pushed.
+   *
    * @return all metrics in the metricsToCollect snapshot
    */
   std::vector<::prometheus::MetricFamily> Collect() const override
   {
-    if (!collection_lock_.try_lock())
-    {
-      return {};
-    }
+    // Exports only hold the lock to merge already translated families, so it is never held for
+    // long. Skipping the collection instead would push an empty group and wipe it on the gateway.
+    std::lock_guard<std::mutex> guard{collection_lock_};
 
     // copy the intermediate collection, and then clear it
     std::vector<::prometheus::MetricFamily> moved_data;
     moved_data.swap(metrics_to_collect_);
     metrics_to_collect_.reserve(max_collection_size_.load(std::memory_order_acquire));
-
-    collection_lock_.unlock();
+    family_index_.clear();
 
     return moved_data;
   }
 
   /**
    * This function is called by export() function and add the collection of
-   * records to the metricsToCollect collection
+   * records to the metricsToCollect collection.
+   *
+   * A family already waiting to be pushed is replaced by the new one: metrics are cumulative,
+   * so the latest snapshot supersedes the previous ones.
    *
    * @param records a collection of records to add to the metricsToCollect
    * collection
+   * @return false if the families do not fit in the collection, in which case none is added
    */
-  void AddMetricData(const ::opentelemetry::sdk::metrics::ResourceMetrics &data)
+  bool AddMetricData(const ::opentelemetry::sdk::metrics::ResourceMetrics &data)
   {
-    auto translated =
-        ::opentelemetry::exporter::metrics::PrometheusExporterUtils::TranslateToPrometheus(data);
+    auto translated = translator_.Translate(data);
 
     std::lock_guard<std::mutex> guard{collection_lock_};
 
+    std::size_t new_families = 0;
+    for (auto &item : translated)
+    {
+      if (family_index_.find(item.name) == family_index_.end())
+      {
+        ++new_families;
+      }
+    }
+    if (metrics_to_collect_.size() + new_families >
+        max_collection_size_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
     for (auto &item : translated)
     {
-      if (metrics_to_collect_.size() + 1 <= max_collection_size_.load(std::memory_order_acquire))
+      auto found = family_index_.find(item.name);
+      if (found != family_index_.end())
       {
-        // We can not use initializer lists here due to broken variadic capture
-        // on GCC 4.8.5
-        metrics_to_collect_.emplace_back(std::move(item));
+        metrics_to_collect_[found->second] = std::move(item);
+        continue;
       }
+      family_index_.emplace(item.name, metrics_to_collect_.size());
+      // We can not use initializer lists here due to broken variadic capture
+      // on GCC 4.8.5
+      metrics_to_collect_.emplace_back(std::move(item));
     }
+    return true;
+  }
+
+  /**
+   * Drop every pending family.
+   */
+  void Clear()
+  {
+    std::lock_guard<std::mutex> guard{collection_lock_};
+    metrics_to_collect_.clear();
+    family_index_.clear();
+  }
+
+  /**
+   * Fill the translation counters of the statistics.
+   */
+  void GetStatistics(PrometheusPushStatistics &statistics) const
+  {
+    translator_.GetStatistics(statistics);
   }
 
   /**
@@ -162,6 +663,11 @@ class PrometheusPushCollector : public ::prometheus::Collectable
    */
   mutable std::vector<::prometheus::MetricFamily> metrics_to_collect_;
 
+  /**
+   * Position of each pending family in metricsToCollect, by family name.
+   */
+  mutable std::unordered_map<std::string, std::size_t> family_index_;
+
   /**
    * Maximum size of the metricsToCollect collection.
    */
@@ -171,6 +677,411 @@ class PrometheusPushCollector : public ::prometheus::Collectable
    * Lock when operating the metricsToCollect collection
    */
   mutable std::mutex collection_lock_;
+
+  /**
+   * Translation of the exports, with the names interned across exports.
+   */
+  PrometheusPushTranslator translator_;
+};
+
+constexpr std::array<double, 11> PrometheusPushStatistics::kLatencyBoundariesMs;
+
+/**
+ * Thread safe accumulator of PrometheusPushStatistics.
+ */
+class PrometheusPushStatisticsRecorder
+{
+public:
+  void RecordPush(std::chrono::microseconds latency,
+                  int http_code,
+                  std::size_t payload_bytes,
+                  std::size_t series)
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+    ++statistics_.pushes;
+    if (http_code < 200 || http_code >= 300)
+    {
+      ++statistics_.failed_pushes;
+    }
+    ++statistics_.http_status[http_code];
+
+    statistics_.payload_bytes += payload_bytes;
+    statistics_.last_payload_bytes = payload_bytes;
+    statistics_.series += series;
+    statistics_.last_series = series;
+
+    statistics_.push_latency += latency;
+    statistics_.last_push_latency = latency;
+    statistics_.max_push_latency  = (std::max)(statistics_.max_push_latency, latency);
+
+    const auto &boundaries = PrometheusPushStatistics::kLatencyBoundariesMs;
+    double latency_ms      = static_cast<double>(latency.count()) / 1000.0;
+    auto bucket = std::lower_bound(boundaries.begin(), boundaries.end(), latency_ms);
+    ++statistics_.latency_buckets[static_cast<std::size_t>(bucket - boundaries.begin())];
+  }
+
+  void RecordDroppedExport()
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+    ++statistics_.dropped_exports;
+  }
+
+  PrometheusPushStatistics Get() const
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+    return statistics_;
+  }
+
+  /**
+   * Append the statistics as otel_prometheus_push_* families.
+   */
+  void AppendFamilies(std::vector<::prometheus::MetricFamily> &families) const
+  {
+    PrometheusPushStatistics statistics = Get();
+
+    auto add_family = [&families](const char *name, const char *help,
+                                  ::prometheus::MetricType type) {
+      families.emplace_back();
+      families.back().name = name;
+      families.back().help = help;
+      families.back().type = type;
+      return &families.back();
+    };
+    auto add_counter = [&add_family](const char *name, const char *help, std::uint64_t value) {
+      auto *family = add_family(name, help, ::prometheus::MetricType::Counter);
+      family->metric.emplace_back();
+      family->metric.back().counter.value = static_cast<double>(value);
+    };
+    auto add_gauge = [&add_family](const char *name, const char *help, std::uint64_t value) {
+      auto *family = add_family(name, help, ::prometheus::MetricType::Gauge);
+      family->metric.emplace_back();
+      family->metric.back().gauge.value = static_cast<double>(value);
+    };
+
+    add_counter("otel_prometheus_push_pushes_total", "Number of pushes to the gateway.",
+                statistics.pushes);
+    add_counter("otel_prometheus_push_failed_pushes_total", "Number of pushes not accepted.",
+                statistics.failed_pushes);
+    add_counter("otel_prometheus_push_dropped_exports_total",
+                "Number of exports rejected because the collection was full.",
+                statistics.dropped_exports);
+    add_gauge("otel_prometheus_push_payload_bytes", "Request body size of the last push.",
+              statistics.last_payload_bytes);
+    add_gauge("otel_prometheus_push_series", "Number of series in the last push.",
+              statistics.last_series);
+
+    auto *responses = add_family("otel_prometheus_push_responses_total",
+                                 "Number of pushes by HTTP status code, negative on transport "
+                                 "errors.",
+                                 ::prometheus::MetricType::Counter);
+    for (const auto &status : statistics.http_status)
+    {
+      responses->metric.emplace_back();
+      responses->metric.back().label.push_back({"code", std::to_string(status.first)});
+      responses->metric.back().counter.value = static_cast<double>(status.second);
+    }
+
+    auto *latency = add_family("otel_prometheus_push_latency_seconds",
+                               "Latency of the pushes to the gateway.",
+                               ::prometheus::MetricType::Histogram);
+    latency->metric.emplace_back();
+    auto &histogram = latency->metric.back().histogram;
+    std::uint64_t cumulative_count = 0;
+    for (std::size_t i = 0; i < statistics.latency_buckets.size(); ++i)
+    {
+      cumulative_count += statistics.latency_buckets[i];
+      ::prometheus::ClientMetric::Bucket bucket;
+      bucket.cumulative_count = cumulative_count;
+      bucket.upper_bound      = i < PrometheusPushStatistics::kLatencyBoundariesMs.size()
+                                    ? PrometheusPushStatistics::kLatencyBoundariesMs[i] / 1000.0
+                                    : std::numeric_limits<double>::infinity();
+      histogram.bucket.push_back(bucket);
+    }
+    histogram.sample_count = statistics.pushes;
+    histogram.sample_sum   = static_cast<double>(statistics.push_latency.count()) / 1000000.0;
+  }
+
+private:
+  mutable std::mutex lock_;
+  PrometheusPushStatistics statistics_;
+};
+
+/**
+ * Thread pushing in the background. Requests only bump the requested push
+ * count, so the requests queued during a push are coalesced into the next
+ * one. Used for the async push of the collection and for the shards.
+ */
+class PrometheusPushWorker
+{
+public:
+  explicit PrometheusPushWorker(std::function<bool()> push)
+      : push_(std::move(push)), thread_(&PrometheusPushWorker::Run, this)
+  {}
+
+  ~PrometheusPushWorker() { Stop(); }
+
+  /**
+   * Ask for the pending collection to be pushed.
+   * @return false if the worker is stopped, and nothing will be pushed
+   */
+  bool Request()
+  {
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      if (stop_)
+      {
+        return false;
+      }
+      ++requested_;
+    }
+    request_cv_.notify_one();
+    return true;
+  }
+
+  /**
+   * Wait until every push requested so far has completed.
+   * @return false on timeout, or if the last completed push failed
+   */
+  bool Flush(std::chrono::microseconds timeout)
+  {
+    std::unique_lock<std::mutex> guard{lock_};
+    std::size_t requested = requested_;
+    auto pushed           = [this, requested] { return completed_ >= requested; };
+    if (timeout == (std::chrono::microseconds::max)())
+    {
+      completed_cv_.wait(guard, pushed);
+    }
+    else if (!completed_cv_.wait_for(guard, timeout, pushed))
+    {
+      return false;
+    }
+    return last_push_succeeded_;
+  }
+
+  /**
+   * Push what is still requested, then join the thread.
+   */
+  void Stop()
+  {
+    if (!thread_.joinable())
+    {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      stop_ = true;
+    }
+    request_cv_.notify_one();
+    thread_.join();
+  }
+
+private:
+  void Run()
+  {
+    std::unique_lock<std::mutex> guard{lock_};
+    while (true)
+    {
+      request_cv_.wait(guard, [this] { return stop_ || requested_ != completed_; });
+      if (requested_ == completed_)
+      {
+        // Stopped and every requested push is done.
+        break;
+      }
+
+      std::size_t requested = requested_;
+      guard.unlock();
+
+      bool succeeded = push_();
+
+      guard.lock();
+      completed_           = requested;
+      last_push_succeeded_ = succeeded;
+      completed_cv_.notify_all();
+    }
+  }
+
+  std::function<bool()> push_;
+  std::mutex lock_;
+  std::condition_variable request_cv_;
+  std::condition_variable completed_cv_;
+  // Number of pushes requested, and number of them covered by a completed push.
+  std::size_t requested_ = 0;
+  std::size_t completed_    = 0;
+  bool last_push_succeeded_ = true;
+  bool stop_                = false;
+  std::thread thread_;
+};
+
+/**
+ * Gateways, or grouping keys, the metric families are spread over. A family
+ * always goes to the same shard: shards are placed on a consistent hash ring
+ * with virtual nodes, so adding a shard only moves the families it takes
+ * over. Shards are pushed in parallel: the first one by the pushing thread,
+ * the others by a worker thread of their own, kept for the exporter lifetime.
+ */
+class PrometheusPushShards
+{
+public:
+  PrometheusPushShards(const PrometheusPushExporterOptions &options,
+                       PrometheusPushStatisticsRecorder &statistics)
+      : statistics_(statistics), export_self_metrics_(options.export_self_metrics)
+  {
+    std::vector<PrometheusPushGateway> gateways = options.shards;
+    if (gateways.empty())
+    {
+      gateways.push_back({options.host, options.port, {}});
+    }
+
+    for (const auto &gateway : gateways)
+    {
+      PrometheusPushExporterOptions shard_options = options;
+      shard_options.host = gateway.host.empty() ? options.host : gateway.host;
+      shard_options.port = gateway.port.empty() ? options.port : gateway.port;
+
+      ::prometheus::Labels labels;
+      for (auto &label : options.labels)
+      {
+        labels[SanitizePrometheusNames(label.first, true)] = label.second;
+      }
+      for (auto &label : gateway.labels)
+      {
+        labels[SanitizePrometheusNames(label.first, true)] = label.second;
+      }
+
+      std::size_t shard = clients_.size();
+      clients_.emplace_back(new PrometheusPushClient(shard_options, labels));
+      for (std::size_t replica = 0; replica < kVirtualNodes; ++replica)
+      {
+        ring_.emplace_back(Hash(clients_.back()->GetUrl() + "#" + std::to_string(replica)),
+                           shard);
+      }
+    }
+    std::sort(ring_.begin(), ring_.end());
+    shard_families_.resize(clients_.size());
+
+    for (std::size_t shard = 1; shard < clients_.size(); ++shard)
+    {
+      workers_.emplace_back(new PrometheusPushWorker([this, shard] { return PushShard(shard); }));
+    }
+  }
+
+  /**
+   * Push the pending collection. Nothing is sent to a shard without pending
+   * families: an empty PUT would delete its grouping key.
+   * @return true if every shard accepted its families
+   */
+  bool Push(PrometheusPushCollector &collector)
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+
+    std::vector<::prometheus::MetricFamily> families = collector.Collect();
+    if (families.empty())
+    {
+      return true;
+    }
+
+    for (auto &shard_families : shard_families_)
+    {
+      shard_families.clear();
+    }
+    for (auto &family : families)
+    {
+      shard_families_[Locate(family.name)].push_back(std::move(family));
+    }
+    if (export_self_metrics_)
+    {
+      statistics_.AppendFamilies(shard_families_[0]);
+    }
+
+    // The shard families stay untouched until every worker is done with them.
+    for (std::size_t shard = 1; shard < clients_.size(); ++shard)
+    {
+      if (!shard_families_[shard].empty())
+      {
+        workers_[shard - 1]->Request();
+      }
+    }
+    bool accepted = shard_families_[0].empty() || PushShard(0);
+    for (std::size_t shard = 1; shard < clients_.size(); ++shard)
+    {
+      if (!shard_families_[shard].empty() &&
+          !workers_[shard - 1]->Flush((std::chrono::microseconds::max)()))
+      {
+        accepted = false;
+      }
+    }
+
+    return accepted;
+  }
+
+private:
+  static constexpr std::size_t kVirtualNodes = 64;
+
+  /**
+   * FNV-1a, stable across processes and standard libraries.
+   */
+  static std::uint64_t Hash(const std::string &value)
+  {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : value)
+    {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  std::size_t Locate(const std::string &family_name) const
+  {
+    if (clients_.size() == 1)
+    {
+      return 0;
+    }
+    auto node = std::lower_bound(ring_.begin(), ring_.end(),
+                                 std::make_pair(Hash(family_name), std::size_t{0}));
+    return node == ring_.end() ? ring_.front().second : node->second;
+  }
+
+  bool PushShard(std::size_t shard)
+  {
+    const auto &families = shard_families_[shard];
+    std::size_t series   = 0;
+    for (const auto &family : families)
+    {
+      series += family.metric.size();
+    }
+
+    std::size_t payload_bytes = 0;
+    auto start                = std::chrono::steady_clock::now();
+    int http_code             = clients_[shard]->Push(families, &payload_bytes);
+    statistics_.RecordPush(std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start),
+                           http_code, payload_bytes, series);
+
+    if (http_code >= 200 && http_code < 300)
+    {
+      return true;
+    }
+    OTEL_INTERNAL_LOG_ERROR("[Prometheus Push Exporter] Push to "
+                            << clients_[shard]->GetUrl() << " failed, HTTP status: " << http_code);
+    return false;
+  }
+
+  PrometheusPushStatisticsRecorder &statistics_;
+  bool export_self_metrics_;
+
+  std::vector<std::unique_ptr<PrometheusPushClient>> clients_;
+  // Virtual nodes, sorted by hash.
+  std::vector<std::pair<std::uint64_t, std::size_t>> ring_;
+
+  // Serializes pushes, and keeps the per shard buffers between them.
+  std::mutex lock_;
+  std::vector<std::vector<::prometheus::MetricFamily>> shard_families_;
+
+  // Workers of the shards after the first one. Declared last, so they are
+  // stopped before the clients and buffers they use are destroyed.
+  std::vector<std::unique_ptr<PrometheusPushWorker>> workers_;
 };
 
 /**
@@ -181,19 +1092,25 @@ class PrometheusPushCollector : public ::prometheus::Collectable
 PrometheusPushExporter::PrometheusPushExporter(const PrometheusPushExporterOptions &options)
     : options_(options), is_shutdown_(false)
 {
-  ::prometheus::Labels labels;
-  for (auto &label : options_.labels)
+  collector_  = std::make_shared<PrometheusPushCollector>(options.max_collection_size);
+  statistics_ = std::unique_ptr<PrometheusPushStatisticsRecorder>(
+      new PrometheusPushStatisticsRecorder());
+  shards_ =
+      std::unique_ptr<PrometheusPushShards>(new PrometheusPushShards(options_, *statistics_));
+
+  if (options_.async_push)
   {
-    labels[SanitizePrometheusNames(label.first, true)] = label.second;
+    PrometheusPushCollector *collector = collector_.get();
+    PrometheusPushShards *shards       = shards_.get();
+    push_worker_.reset(
+        new PrometheusPushWorker([collector, shards] { return shards->Push(*collector); }));
   }
-  gateway_ = std::unique_ptr<::prometheus::Gateway>(
-      new ::prometheus::Gateway{options_.host, options_.port, options_.jobname, labels,
-                                options_.username, options_.password});
-  collector_ = std::make_shared<PrometheusPushCollector>(options.max_collection_size);
-
-  gateway_->RegisterCollectable(collector_);
 }
 
+PrometheusPushExporter::PrometheusPushExporter(PrometheusPushExporter &&other) = default;
+
+PrometheusPushExporter::~PrometheusPushExporter() = default;
+
 /**
  * PrometheusPushExporter constructor with no parameters
  * Used for testing only
@@ -201,7 +1118,9 @@ PrometheusPushExporter::PrometheusPushExporter(const PrometheusPushExporterOptio
 PrometheusPushExporter::PrometheusPushExporter() : is_shutdown_(false)
 {
   const_cast<PrometheusPushExporterOptions &>(options_).max_collection_size = 3;
-  collector_ = std::make_shared<PrometheusPushCollector>(options_.max_collection_size);
+  collector_  = std::make_shared<PrometheusPushCollector>(options_.max_collection_size);
+  statistics_ = std::unique_ptr<PrometheusPushStatisticsRecorder>(
+      new PrometheusPushStatisticsRecorder());
 }
 
 ::opentelemetry::sdk::metrics::AggregationTemporality
@@ -224,48 +1143,60 @@ ::opentelemetry::sdk::common::ExportResult PrometheusPushExporter::Export(
   {
     return ::opentelemetry::sdk::common::ExportResult::kFailure;
   }
-  else if (collector_->GetCollection().size() + data.scope_metric_data_.size() >
-           collector_->GetMaxCollectionSize())
-  {
-    return ::opentelemetry::sdk::common::ExportResult::kFailureFull;
-  }
   else if (data.scope_metric_data_.empty())
   {
     return ::opentelemetry::sdk::common::ExportResult::kFailureInvalidArgument;
   }
-  else
+  else if (!collector_->AddMetricData(data))
   {
-    collector_->AddMetricData(data);
-    if (gateway_)
+    statistics_->RecordDroppedExport();
+    return ::opentelemetry::sdk::common::ExportResult::kFailureFull;
+  }
+  else if (push_worker_)
+  {
+    // Shutdown may have stopped the worker since is_shutdown_ was checked.
+    if (!push_worker_->Request())
     {
-      int http_code = gateway_->Push();
-      if (http_code >= 200 && http_code < 300)
-      {
-        return ::opentelemetry::sdk::common::ExportResult::kSuccess;
-      }
       return ::opentelemetry::sdk::common::ExportResult::kFailure;
     }
     return ::opentelemetry::sdk::common::ExportResult::kSuccess;
   }
+  else if (shards_ && !shards_->Push(*collector_))
+  {
+    return ::opentelemetry::sdk::common::ExportResult::kFailure;
+  }
+  return ::opentelemetry::sdk::common::ExportResult::kSuccess;
 }
 
-bool PrometheusPushExporter::ForceFlush(std::chrono::microseconds /*timeout*/) noexcept
+bool PrometheusPushExporter::ForceFlush(std::chrono::microseconds timeout) noexcept
 {
+  if (push_worker_)
+  {
+    // Exports request their push, so there is nothing to request here: a push of the empty
+    // collection would hide the result of the last one.
+    return push_worker_->Flush(timeout);
+  }
+  if (shards_)
+  {
+    return shards_->Push(*collector_);
+  }
   return true;
 }
 
 /**
  * Shuts down the exporter and does cleanup.
- * Since Prometheus is a pull based interface,
- * we cannot serve data remaining in the intermediate
- * collection to to client an HTTP request being sent,
- * so we flush the data.
+ * Metrics already queued for the push thread are pushed, then the remaining
+ * intermediate collection is dropped.
  */
 bool PrometheusPushExporter::Shutdown(std::chrono::microseconds /*timeout*/) noexcept
 {
   is_shutdown_ = true;
 
-  collector_->GetCollection().clear();
+  if (push_worker_)
+  {
+    push_worker_->Stop();
+  }
+  collector_->Clear();
 
   return true;
 }
@@ -280,6 +1211,13 @@ std::size_t PrometheusPushExporter::GetMaxCollectionSize() const noexcept
   return collector_->GetMaxCollectionSize();
 }
 
+PrometheusPushStatistics PrometheusPushExporter::GetStatistics() const
+{
+  PrometheusPushStatistics statistics = statistics_->Get();
+  collector_->GetStatistics(statistics);
+  return statistics;
+}
+
 /**
  * @return: Gets the shutdown status of the exporter
  */
@@ -0,0 +1,148 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include <benchmark/benchmark.h>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opentelemetry/exporters/prometheus/exporter_utils.h"
+#include "opentelemetry/exporters/prometheus/push_exporter.h"
+#include "opentelemetry/exporters/prometheus/push_exporter_options.h"
+#include "opentelemetry/sdk/instrumentationscope/instrumentation_scope.h"
+#include "opentelemetry/sdk/metrics/export/metric_producer.h"
+#include "opentelemetry/sdk/resource/resource.h"
+#include "prometheus_test_helper.h"
+#include "pushgateway_stand_in.h"
+
+using opentelemetry::exporter::metrics::PrometheusExporterUtils;
+using opentelemetry::exporter::metrics::PrometheusPushExporter;
+using opentelemetry::exporter::metrics::PrometheusPushExporterOptions;
+using opentelemetry::exporter::metrics::PrometheusPushFormat;
+
+namespace
+{
+
+/**
+ * Counters with `metrics` instruments of `series` points each.
+ */
+metric_sdk::ResourceMetrics CreateResourceMetrics(
+    opentelemetry::sdk::instrumentationscope::InstrumentationScope *scope,
+    int64_t metrics,
+    int64_t series)
+{
+  metric_sdk::ResourceMetrics data;
+  data.resource_ = &GetEmptyResource();
+
+  metric_sdk::ScopeMetrics scope_metrics;
+  scope_metrics.scope_ = scope;
+  for (int64_t i = 0; i < metrics; ++i)
+  {
+    metric_sdk::MetricData metric_data;
+    metric_data.instrument_descriptor =
+        metric_sdk::InstrumentDescriptor{"metric_" + std::to_string(i), "description", "unit",
+                                         metric_sdk::InstrumentType::kCounter,
+                                         metric_sdk::InstrumentValueType::kDouble};
+    metric_data.aggregation_temporality = metric_sdk::AggregationTemporality::kCumulative;
+    for (int64_t j = 0; j < series; ++j)
+    {
+      metric_sdk::SumPointData sum_point_data{};
+      sum_point_data.value_ = static_cast<double>(j);
+      metric_data.point_data_attr_.push_back(
+          {metric_sdk::PointAttributes{{"series", std::to_string(j)}}, sum_point_data});
+    }
+    scope_metrics.metric_data_.push_back(std::move(metric_data));
+  }
+  data.scope_metric_data_.push_back(std::move(scope_metrics));
+  return data;
+}
+
+void ReportMaxRss(benchmark::State &state)
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+  {
+    // Linux reports kilobytes.
+    state.counters["max_rss_kb"] = static_cast<double>(usage.ru_maxrss);
+  }
+}
+
+std::unique_ptr<opentelemetry::sdk::instrumentationscope::InstrumentationScope> CreateScope()
+{
+  return opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("benchmark",
+                                                                                "1.0.0");
+}
+
+// Arg 0: number of metrics, Arg 1: series per metric.
+void BM_TranslateToPrometheus(benchmark::State &state)
+{
+  auto scope = CreateScope();
+  auto data  = CreateResourceMetrics(scope.get(), state.range(0), state.range(1));
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(PrometheusExporterUtils::TranslateToPrometheus(data));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+  ReportMaxRss(state);
+}
+BENCHMARK(BM_TranslateToPrometheus)
+    ->ArgsProduct({{1, 10, 100}, {1, 10, 100}})
+    ->ArgNames({"metrics", "series"});
+
+// Synchronous export to the stand-in: translation, serialization and push.
+// Arg 0: number of metrics, Arg 1: series per metric, Arg 2: 1 for protobuf and gzip.
+void BM_PushExport(benchmark::State &state)
+{
+  PushgatewayStandIn gateway;
+
+  PrometheusPushExporterOptions options;
+  options.host    = gateway.GetHost();
+  options.port    = gateway.GetPort();
+  options.jobname = "benchmark";
+  if (state.range(2) != 0)
+  {
+    options.format           = PrometheusPushFormat::kProtobuf;
+    options.gzip_compression = true;
+  }
+  options.max_collection_size = static_cast<std::size_t>(state.range(0)) + 1;
+  PrometheusPushExporter exporter(options);
+
+  auto scope = CreateScope();
+  auto data  = CreateResourceMetrics(scope.get(), state.range(0), state.range(1));
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(exporter.Export(data));
+
+    state.PauseTiming();
+    gateway.ClearRequests();
+    state.ResumeTiming();
+  }
+
+  auto statistics = exporter.GetStatistics();
+  if (statistics.pushes != 0)
+  {
+    state.counters["push_latency_us"] =
+        static_cast<double>(statistics.push_latency.count()) / statistics.pushes;
+    state.counters["max_push_latency_us"] =
+        static_cast<double>(statistics.max_push_latency.count());
+    state.counters["payload_bytes"] = static_cast<double>(statistics.last_payload_bytes);
+  }
+  state.counters["failed_pushes"] = static_cast<double>(statistics.failed_pushes);
+  state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+  ReportMaxRss(state);
+}
+BENCHMARK(BM_PushExport)
+    ->ArgsProduct({{1, 10, 100}, {1, 10, 100}, {0, 1}})
+    ->ArgNames({"metrics", "series", "protobuf_gzip"})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
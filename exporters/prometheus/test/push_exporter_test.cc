@@ -6,16 +6,25 @@
 #include <chrono>
 #include <cstddef>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "opentelemetry/exporters/prometheus/collector.h"
 
+#include "opentelemetry/exporters/prometheus/push_client.h"
 #include "opentelemetry/exporters/prometheus/push_exporter.h"
 #include "opentelemetry/exporters/prometheus/push_exporter_factory.h"
 #include "opentelemetry/exporters/prometheus/push_exporter_options.h"
 #include "prometheus_test_helper.h"
+#include "pushgateway_stand_in.h"
 
 using opentelemetry::exporter::metrics::PrometheusCollector;
+using opentelemetry::exporter::metrics::PrometheusPushClient;
+using opentelemetry::exporter::metrics::PrometheusPushFormat;
+using opentelemetry::exporter::metrics::PrometheusPushGateway;
+using opentelemetry::exporter::metrics::PrometheusPushMethod;
 using opentelemetry::exporter::metrics::PrometheusPushExporter;
 using opentelemetry::exporter::metrics::PrometheusPushExporterFactory;
 using opentelemetry::exporter::metrics::PrometheusPushExporterOptions;
@@ -152,18 +161,21 @@ TEST(PrometheusPushExporter, CollectionNotEnoughSpace)
 
   // send export request to fill the
   // collection in the collector
-  // In each loop, there are 2 collections:
-  // - the instrumentation_scope
-  // - the data
+  // Each metric name is a new family, target_info is shared by all exports.
   ExportResult code = ExportResult::kSuccess;
-  for (int count = 1; count <= max_collection_size; count += 2)
+  int count         = 1;
+  for (; count < max_collection_size; ++count)
   {
     auto data = CreateSumPointData(instrumentation_scope.get());
-    auto res  = exporter.Export(data);
+    data.scope_metric_data_[0].metric_data_[0].instrument_descriptor.name_ =
+        "metric_" + std::to_string(count);
+    auto res = exporter.Export(data);
     ASSERT_EQ(res, code);
   }
 
   auto data = CreateSumPointData(instrumentation_scope.get());
+  data.scope_metric_data_[0].metric_data_[0].instrument_descriptor.name_ =
+      "metric_" + std::to_string(count);
 
   // send export request that does not complete
   // due to not enough space in the collection
@@ -172,6 +184,32 @@ TEST(PrometheusPushExporter, CollectionNotEnoughSpace)
   // the result code should be kFailureFull = 2
   code = ExportResult::kFailureFull;
   ASSERT_EQ(res, code);
+
+  // the rejected export is counted, nothing was pushed without a gateway
+  auto statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.dropped_exports, 1u);
+  ASSERT_EQ(statistics.pushes, 0u);
+  ASSERT_TRUE(exporter.ForceFlush());
+}
+
+/**
+ * Families exported again before being pushed replace the pending ones,
+ * so they never fill the collection.
+ */
+TEST(PrometheusPushExporter, CoalesceSameFamilies)
+{
+  PrometheusPushExporterTest p;
+  PrometheusPushExporter exporter = p.GetExporter();
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+
+  for (std::size_t count = 0; count <= 2 * exporter.GetMaxCollectionSize(); ++count)
+  {
+    auto data = CreateSumPointData(instrumentation_scope.get());
+    ASSERT_EQ(exporter.Export(data), ExportResult::kSuccess);
+  }
 }
 
 /**
@@ -216,3 +254,315 @@ TEST(PrometheusPushExporterFactory, Create)
 
   p.CheckFactory(*static_cast<PrometheusPushExporter *>(exporter.get()), options);
 }
+
+TEST(PrometheusPushClient, SerializeProtobufDelimited)
+{
+  ::prometheus::MetricFamily family;
+  family.name = "requests_total";
+  family.help = "help";
+  family.type = ::prometheus::MetricType::Counter;
+  family.metric.resize(1);
+  family.metric[0].label.push_back({"method", "GET"});
+  family.metric[0].counter.value = 1.0;
+
+  std::string body;
+  PrometheusPushClient::Serialize({family, family}, PrometheusPushFormat::kProtobuf, body);
+
+  // Two identical messages, each prefixed by its one byte size.
+  ASSERT_FALSE(body.empty());
+  std::size_t size = static_cast<unsigned char>(body[0]);
+  ASSERT_LT(size, 0x80u);
+  ASSERT_EQ(body.size(), 2 * (size + 1));
+  ASSERT_EQ(body.substr(0, size + 1), body.substr(size + 1));
+
+  // name = 1
+  ASSERT_EQ(body[1], 0x0A);
+  ASSERT_EQ(body.substr(3, family.name.size()), family.name);
+}
+
+TEST(PrometheusPushClient, CompressGzip)
+{
+  std::string body;
+  for (int i = 0; i < 100; ++i)
+  {
+    body += "requests_total{method=\"GET\"} 1\n";
+  }
+
+  std::string compressed;
+  ASSERT_TRUE(PrometheusPushClient::Compress(body, compressed));
+  ASSERT_LT(compressed.size(), body.size());
+
+  // gzip magic
+  ASSERT_EQ(static_cast<unsigned char>(compressed[0]), 0x1f);
+  ASSERT_EQ(static_cast<unsigned char>(compressed[1]), 0x8b);
+}
+
+#ifndef _WIN32
+namespace
+{
+PrometheusPushExporterOptions StandInOptions(PushgatewayStandIn &gateway)
+{
+  PrometheusPushExporterOptions options;
+  options.host                 = gateway.GetHost();
+  options.port                 = gateway.GetPort();
+  options.jobname              = "jobname";
+  options.labels["test_label"] = "test_value";
+  return options;
+}
+}  // namespace
+
+TEST(PrometheusPushExporter, PushToStandIn)
+{
+  PushgatewayStandIn gateway;
+  PrometheusPushExporter exporter(StandInOptions(gateway));
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+  ASSERT_EQ(exporter.Export(CreateSumPointData(instrumentation_scope.get())),
+            ExportResult::kSuccess);
+
+  auto requests = gateway.GetRequests();
+  ASSERT_EQ(requests.size(), 1u);
+  ASSERT_EQ(requests[0].method, "PUT");
+  ASSERT_EQ(requests[0].path, "/metrics/job/jobname/test_label/test_value");
+  ASSERT_EQ(requests[0].content_type.find("text/plain"), 0u);
+  ASSERT_NE(requests[0].body.find("library_name"), std::string::npos);
+
+  auto statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.pushes, 1u);
+  ASSERT_EQ(statistics.http_status[200], 1u);
+  ASSERT_EQ(statistics.last_payload_bytes, requests[0].body.size());
+
+  // Nothing is pending, so flushing does not push an empty group.
+  ASSERT_TRUE(exporter.ForceFlush());
+  ASSERT_EQ(gateway.GetRequests().size(), 1u);
+}
+
+TEST(PrometheusPushExporter, PushAddProtobufGzipToStandIn)
+{
+  PushgatewayStandIn gateway;
+  auto options             = StandInOptions(gateway);
+  options.format           = PrometheusPushFormat::kProtobuf;
+  options.method           = PrometheusPushMethod::kPushAdd;
+  options.gzip_compression = true;
+  PrometheusPushExporter exporter(options);
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+  ASSERT_EQ(exporter.Export(CreateSumPointData(instrumentation_scope.get())),
+            ExportResult::kSuccess);
+
+  auto requests = gateway.GetRequests();
+  ASSERT_EQ(requests.size(), 1u);
+  ASSERT_EQ(requests[0].method, "POST");
+  ASSERT_EQ(requests[0].content_type.find("application/vnd.google.protobuf"), 0u);
+  ASSERT_EQ(requests[0].content_encoding, "gzip");
+}
+
+/**
+ * The names sanitized by the first export are interned, the second export of
+ * the same series reuses them and pushes the same families.
+ */
+TEST(PrometheusPushExporter, InternNamesAcrossExports)
+{
+  PushgatewayStandIn gateway;
+  PrometheusPushExporter exporter(StandInOptions(gateway));
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+  auto data = CreateSumPointData(instrumentation_scope.get());
+  data.scope_metric_data_[0].metric_data_[0].instrument_descriptor.name_ = "library.name-total";
+
+  ASSERT_EQ(exporter.Export(data), ExportResult::kSuccess);
+  auto statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.translated_metrics, 1u);
+  ASSERT_EQ(statistics.interned_metrics, 0u);
+
+  ASSERT_EQ(exporter.Export(data), ExportResult::kSuccess);
+  statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.translated_metrics, 1u);
+  ASSERT_EQ(statistics.interned_metrics, 1u);
+
+  auto requests = gateway.GetRequests();
+  ASSERT_EQ(requests.size(), 2u);
+  ASSERT_EQ(requests[1].body, requests[0].body);
+  ASSERT_EQ(requests[1].body.find("library.name"), std::string::npos);
+
+  // A series not seen before is translated again.
+  data.scope_metric_data_[0].metric_data_[0].point_data_attr_[0].attributes.SetAttribute("a3",
+                                                                                        "b3");
+  ASSERT_EQ(exporter.Export(data), ExportResult::kSuccess);
+  statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.translated_metrics, 2u);
+  ASSERT_EQ(statistics.interned_metrics, 1u);
+}
+
+TEST(PrometheusPushExporter, AsyncPushToSlowStandIn)
+{
+  PushgatewayStandIn gateway;
+  gateway.SetDelay(std::chrono::milliseconds(200));
+  gateway.SetStatusCode(503);
+  auto options       = StandInOptions(gateway);
+  options.async_push = true;
+  PrometheusPushExporter exporter(options);
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+
+  // Export does not wait for the gateway.
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(exporter.Export(CreateSumPointData(instrumentation_scope.get())),
+            ExportResult::kSuccess);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(200));
+
+  // The gateway answers 503, so flushing reports the failed push.
+  ASSERT_FALSE(exporter.ForceFlush());
+  ASSERT_TRUE(gateway.WaitForRequests(1));
+
+  auto statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.pushes, 1u);
+  ASSERT_EQ(statistics.failed_pushes, 1u);
+  ASSERT_EQ(statistics.http_status[503], 1u);
+  ASSERT_GE(statistics.last_push_latency, std::chrono::milliseconds(200));
+
+  ASSERT_TRUE(exporter.Shutdown());
+}
+
+TEST(PrometheusPushExporter, PushTimeoutToSlowStandIn)
+{
+  PushgatewayStandIn gateway;
+  gateway.SetDelay(std::chrono::milliseconds(1000));
+  auto options         = StandInOptions(gateway);
+  options.push_timeout = std::chrono::milliseconds(100);
+  PrometheusPushExporter exporter(options);
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+
+  // The push is aborted long before the gateway answers.
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(exporter.Export(CreateSumPointData(instrumentation_scope.get())),
+            ExportResult::kFailure);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+  auto statistics = exporter.GetStatistics();
+  ASSERT_EQ(statistics.failed_pushes, 1u);
+}
+
+/**
+ * Families are spread over the shards, each family always on the same one.
+ */
+TEST(PrometheusPushExporter, ShardFamiliesAcrossStandIns)
+{
+  PushgatewayStandIn gateway_a;
+  PushgatewayStandIn gateway_b;
+  auto options = StandInOptions(gateway_a);
+  options.shards.push_back(PrometheusPushGateway{"", "", {{"shard", "a"}}});
+  options.shards.push_back(
+      PrometheusPushGateway{gateway_b.GetHost(), gateway_b.GetPort(), {{"shard", "b"}}});
+  PrometheusPushExporter exporter(options);
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+  const int kMetrics = 32;
+  auto data          = CreateSumPointData(instrumentation_scope.get());
+  auto metric_data   = data.scope_metric_data_[0].metric_data_[0];
+  data.scope_metric_data_[0].metric_data_.clear();
+  for (int i = 0; i < kMetrics; ++i)
+  {
+    metric_data.instrument_descriptor.name_ = "sharded_" + std::to_string(i) + "_metric";
+    data.scope_metric_data_[0].metric_data_.push_back(metric_data);
+  }
+
+  for (int round = 1; round <= 2; ++round)
+  {
+    ASSERT_EQ(exporter.Export(data), ExportResult::kSuccess);
+
+    auto requests_a = gateway_a.GetRequests();
+    auto requests_b = gateway_b.GetRequests();
+    ASSERT_EQ(requests_a.size(), static_cast<std::size_t>(round));
+    ASSERT_EQ(requests_b.size(), static_cast<std::size_t>(round));
+    ASSERT_NE(requests_a.back().path.find("/shard/a"), std::string::npos);
+    ASSERT_NE(requests_b.back().path.find("/shard/b"), std::string::npos);
+    ASSERT_NE(requests_b.back().path.find("/test_label/test_value"), std::string::npos);
+
+    for (int i = 0; i < kMetrics; ++i)
+    {
+      std::string name = "sharded_" + std::to_string(i) + "_metric";
+      bool on_a        = requests_a.back().body.find(name) != std::string::npos;
+      bool on_b        = requests_b.back().body.find(name) != std::string::npos;
+      ASSERT_NE(on_a, on_b) << name;
+      if (round == 2)
+      {
+        ASSERT_EQ(on_a, requests_a.front().body.find(name) != std::string::npos) << name;
+      }
+    }
+  }
+
+  ASSERT_EQ(exporter.GetStatistics().pushes, 4u);
+}
+
+/**
+ * An asynchronous Export racing with Shutdown either fails, or has its metrics pushed.
+ */
+TEST(PrometheusPushExporter, AsyncExportRacingShutdown)
+{
+  PushgatewayStandIn gateway;
+  auto options       = StandInOptions(gateway);
+  options.async_push = true;
+  PrometheusPushExporter exporter(options);
+
+  auto instrumentation_scope =
+      opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("library_name",
+                                                                             "1.15.0");
+  auto data = CreateSumPointData(instrumentation_scope.get());
+
+  const int kThreads = 4;
+  const int kExports = 50;
+  std::mutex exported_lock;
+  std::vector<std::string> exported;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t)
+  {
+    threads.emplace_back([&, t] {
+      auto thread_data = data;
+      for (int i = 0; i < kExports; ++i)
+      {
+        // Distinct families, so that pending exports are not coalesced.
+        std::string name = "raced_" + std::to_string(t) + "_" + std::to_string(i) + "_metric";
+        thread_data.scope_metric_data_[0].metric_data_[0].instrument_descriptor.name_ = name;
+        if (exporter.Export(thread_data) == ExportResult::kSuccess)
+        {
+          std::lock_guard<std::mutex> guard{exported_lock};
+          exported.push_back(name);
+        }
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ASSERT_TRUE(exporter.Shutdown());
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  ASSERT_EQ(exporter.Export(data), ExportResult::kFailure);
+
+  std::string pushed;
+  for (auto &request : gateway.GetRequests())
+  {
+    pushed += request.body;
+  }
+  for (auto &name : exported)
+  {
+    ASSERT_NE(pushed.find(name), std::string::npos) << name;
+  }
+}
+#endif  // _WIN32
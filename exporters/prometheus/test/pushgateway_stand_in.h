@@ -0,0 +1,259 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#ifndef _WIN32
+
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+
+#  include <algorithm>
+#  include <atomic>
+#  include <cctype>
+#  include <chrono>
+#  include <condition_variable>
+#  include <cstdlib>
+#  include <mutex>
+#  include <string>
+#  include <thread>
+#  include <vector>
+
+namespace
+{  // NOLINT
+
+/**
+ * Minimal pushgateway listening on 127.0.0.1, for tests and benchmarks.
+ *
+ * Requests are answered with a configurable status code, optionally after a
+ * delay, and recorded. Connections are kept alive like a real gateway does,
+ * so clients reusing their connection are served too.
+ */
+class PushgatewayStandIn
+{
+public:
+  struct Request
+  {
+    std::string method;
+    std::string path;
+    std::string content_type;
+    std::string content_encoding;
+    std::string body;
+  };
+
+  PushgatewayStandIn()
+  {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int reuse  = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+    ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(listen_fd_, 16);
+
+    socklen_t addr_len = sizeof(addr);
+    ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &addr_len);
+    port_ = ntohs(addr.sin_port);
+
+    accept_thread_ = std::thread(&PushgatewayStandIn::Accept, this);
+  }
+
+  ~PushgatewayStandIn()
+  {
+    stop_ = true;
+    ::shutdown(listen_fd_, SHUT_RDWR);
+    ::close(listen_fd_);
+    accept_thread_.join();
+
+    std::vector<std::thread> connections;
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      for (int fd : connection_fds_)
+      {
+        ::shutdown(fd, SHUT_RDWR);
+      }
+      connections.swap(connection_threads_);
+    }
+    for (auto &connection : connections)
+    {
+      connection.join();
+    }
+    for (int fd : connection_fds_)
+    {
+      ::close(fd);
+    }
+  }
+
+  std::string GetHost() const { return "http://127.0.0.1"; }
+
+  std::string GetPort() const { return std::to_string(port_); }
+
+  void SetStatusCode(int status_code) { status_code_ = status_code; }
+
+  void SetDelay(std::chrono::milliseconds delay) { delay_ms_ = delay.count(); }
+
+  /**
+   * Wait until at least count requests have been received.
+   */
+  bool WaitForRequests(std::size_t count,
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+  {
+    std::unique_lock<std::mutex> guard{lock_};
+    return requests_cv_.wait_for(guard, timeout,
+                                 [this, count] { return requests_.size() >= count; });
+  }
+
+  std::vector<Request> GetRequests()
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+    return requests_;
+  }
+
+  /**
+   * Drop the recorded requests, benchmarks call it to keep memory flat.
+   */
+  void ClearRequests()
+  {
+    std::lock_guard<std::mutex> guard{lock_};
+    requests_.clear();
+  }
+
+private:
+  void Accept()
+  {
+    while (!stop_)
+    {
+      int fd = ::accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0)
+      {
+        continue;
+      }
+      std::lock_guard<std::mutex> guard{lock_};
+      connection_fds_.push_back(fd);
+      connection_threads_.emplace_back(&PushgatewayStandIn::Serve, this, fd);
+    }
+  }
+
+  static std::string Lower(std::string value)
+  {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+  }
+
+  void Serve(int fd)
+  {
+    std::string buffer;
+    char chunk[16 * 1024];
+    while (true)
+    {
+      std::size_t header_end;
+      while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos)
+      {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+        {
+          return;
+        }
+        buffer.append(chunk, static_cast<std::size_t>(received));
+      }
+
+      Request request;
+      std::size_t content_length = 0;
+      std::size_t line_start     = 0;
+      bool first_line            = true;
+      while (line_start < header_end)
+      {
+        std::size_t line_end = buffer.find("\r\n", line_start);
+        std::string line     = buffer.substr(line_start, line_end - line_start);
+        line_start           = line_end + 2;
+        if (first_line)
+        {
+          std::size_t method_end = line.find(' ');
+          std::size_t path_end   = line.find(' ', method_end + 1);
+          request.method         = line.substr(0, method_end);
+          request.path           = line.substr(method_end + 1, path_end - method_end - 1);
+          first_line             = false;
+          continue;
+        }
+        std::size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+          continue;
+        }
+        std::size_t value_start = line.find_first_not_of(' ', colon + 1);
+        std::string name        = Lower(line.substr(0, colon));
+        std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+        if (name == "content-length")
+        {
+          content_length = static_cast<std::size_t>(std::strtoull(value.c_str(), nullptr, 10));
+        }
+        else if (name == "content-type")
+        {
+          request.content_type = value;
+        }
+        else if (name == "content-encoding")
+        {
+          request.content_encoding = value;
+        }
+        else if (name == "expect" && Lower(value) == "100-continue")
+        {
+          // curl waits for it before sending large bodies.
+          static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+          ::send(fd, kContinue, sizeof(kContinue) - 1, MSG_NOSIGNAL);
+        }
+      }
+
+      buffer.erase(0, header_end + 4);
+      while (buffer.size() < content_length)
+      {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+        {
+          return;
+        }
+        buffer.append(chunk, static_cast<std::size_t>(received));
+      }
+      request.body = buffer.substr(0, content_length);
+      buffer.erase(0, content_length);
+
+      if (delay_ms_ > 0)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_.load()));
+      }
+
+      // Recorded before answering, so the request is visible once the push returns.
+      {
+        std::lock_guard<std::mutex> guard{lock_};
+        requests_.push_back(std::move(request));
+      }
+      requests_cv_.notify_all();
+
+      std::string response = "HTTP/1.1 " + std::to_string(status_code_.load()) +
+                             " Stand-in\r\nContent-Length: 0\r\n\r\n";
+      ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+    }
+  }
+
+  int listen_fd_ = -1;
+  uint16_t port_ = 0;
+  std::atomic<bool> stop_{false};
+  std::atomic<int> status_code_{200};
+  std::atomic<long long> delay_ms_{0};
+
+  std::mutex lock_;
+  std::condition_variable requests_cv_;
+  std::vector<Request> requests_;
+  std::vector<int> connection_fds_;
+  std::vector<std::thread> connection_threads_;
+  std::thread accept_thread_;
+};
+
+}  // namespace
+
+#endif  // _WIN32
@@ -7,15 +7,22 @@
 #include "opentelemetry/nostd/shared_ptr.h"
 
 #include "opentelemetry/exporters/user_events/logs/exporter.h"
-#include "opentelemetry/logs/provider.h"
+#include "opentelemetry/exporters/user_events/metrics/exporter.h"
+#include "opentelemetry/sdk/instrumentationscope/instrumentation_scope.h"
+#include "opentelemetry/sdk/logs/batch_log_record_processor_factory.h"
+#include "opentelemetry/sdk/logs/batch_log_record_processor_options.h"
 #include "opentelemetry/sdk/logs/logger_provider_factory.h"
 #include "opentelemetry/sdk/logs/processor.h"
 #include "opentelemetry/sdk/logs/simple_log_record_processor_factory.h"
+#include "opentelemetry/sdk/metrics/export/metric_producer.h"
+#include "opentelemetry/sdk/resource/resource.h"
 
+#include <array>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -158,6 +165,237 @@ static void BM_StructuredLogWithEventIdStructAndTwoAttributes(benchmark::State &
 }
 BENCHMARK(BM_StructuredLogWithEventIdStructAndTwoAttributes);
 
+//
+// Scaling suite. Time is reported per log call (ns/op), "bytes_per_op" is the size of the body
+// and attribute values handed to the logger. "tracepoint_enabled" tells whether a listener was
+// attached to the level while the benchmark ran: without one, records are dropped before
+// encoding, so run e.g. `perf record -e user_events:opentelemetry_logs_L5K1` alongside to
+// measure the enabled path.
+//
+
+enum class ProcessorKind
+{
+  kSimple,
+  kBatch
+};
+
+struct LoggerFixture
+{
+  user_events_logs::Exporter *exporter = nullptr;
+  std::shared_ptr<LoggerProvider> provider;
+  nostd::shared_ptr<Logger> logger;
+};
+
+LoggerFixture &GetLoggerFixture(ProcessorKind kind)
+{
+  static std::array<LoggerFixture, 2> fixtures;
+  static std::array<std::once_flag, 2> once;
+
+  auto index = static_cast<size_t>(kind);
+  std::call_once(once[index], [kind, index]() {
+    auto exporter_options                 = user_events_logs::ExporterOptions();
+    exporter_options.recordable_pool_size = 1024;
+    auto exporter                         = std::unique_ptr<user_events_logs::Exporter>(
+        new user_events_logs::Exporter(exporter_options));
+    fixtures[index].exporter = exporter.get();
+
+    std::unique_ptr<logs_sdk::LogRecordProcessor> processor;
+    if (kind == ProcessorKind::kBatch)
+    {
+      logs_sdk::BatchLogRecordProcessorOptions batch_options;
+      processor = logs_sdk::BatchLogRecordProcessorFactory::Create(std::move(exporter),
+                                                                   batch_options);
+    }
+    else
+    {
+      processor = logs_sdk::SimpleLogRecordProcessorFactory::Create(std::move(exporter));
+    }
+
+    fixtures[index].provider = std::shared_ptr<LoggerProvider>(
+        logs_sdk::LoggerProviderFactory::Create(std::move(processor)));
+    fixtures[index].logger = fixtures[index].provider->GetLogger("UserEventsBenchmark");
+  });
+
+  return fixtures[index];
+}
+
+void ReportCounters(benchmark::State &state,
+                    const LoggerFixture &fixture,
+                    Severity severity,
+                    size_t bytes_per_op)
+{
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes_per_op));
+  state.counters["bytes_per_op"] = static_cast<double>(bytes_per_op);
+  state.counters["tracepoint_enabled"] = fixture.exporter->IsEnabled(severity) ? 1 : 0;
+}
+
+// Arg 0: attribute count, Arg 1: attribute type (0 = int64, 1 = string, 2 = double array).
+static void BM_LogAttributeSweep(benchmark::State &state)
+{
+  auto &fixture       = GetLoggerFixture(ProcessorKind::kSimple);
+  const size_t count  = static_cast<size_t>(state.range(0));
+  const int64_t type  = state.range(1);
+  const double doubles[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0};
+
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < count; i++)
+  {
+    keys.push_back("attribute_" + std::to_string(i));
+  }
+
+  for (auto _ : state)
+  {
+    auto record = fixture.logger->CreateLogRecord();
+    record->SetSeverity(Severity::kInfo);
+    record->SetBody("attribute sweep");
+    for (size_t i = 0; i < count; i++)
+    {
+      if (type == 0)
+      {
+        record->SetAttribute(keys[i], static_cast<int64_t>(i));
+      }
+      else if (type == 1)
+      {
+        record->SetAttribute(keys[i], "attribute value");
+      }
+      else
+      {
+        record->SetAttribute(keys[i], span<const double>(doubles));
+      }
+    }
+    fixture.logger->EmitLogRecord(std::move(record));
+  }
+
+  const size_t value_size = type == 0 ? sizeof(int64_t) : type == 1 ? 15 : sizeof(doubles);
+  ReportCounters(state, fixture, Severity::kInfo, 15 + count * value_size);
+}
+BENCHMARK(BM_LogAttributeSweep)
+    ->ArgsProduct({{0, 1, 4, 16, 64}, {0, 1, 2}})
+    ->ArgNames({"attributes", "type"});
+
+// Arg 0: body size in bytes.
+static void BM_LogBodySize(benchmark::State &state)
+{
+  auto &fixture = GetLoggerFixture(ProcessorKind::kSimple);
+  const std::string body(static_cast<size_t>(state.range(0)), 'x');
+
+  for (auto _ : state)
+  {
+    fixture.logger->Info(body);
+  }
+
+  ReportCounters(state, fixture, Severity::kInfo, body.size());
+}
+BENCHMARK(BM_LogBodySize)->RangeMultiplier(4)->Range(16, 16 << 10)->ArgName("body_bytes");
+
+// Arg 0: severity. Compares a level with a listener against one without.
+static void BM_LogBySeverity(benchmark::State &state)
+{
+  auto &fixture       = GetLoggerFixture(ProcessorKind::kSimple);
+  const auto severity = static_cast<Severity>(state.range(0));
+
+  for (auto _ : state)
+  {
+    auto record = fixture.logger->CreateLogRecord();
+    record->SetSeverity(severity);
+    record->SetBody("severity check");
+    record->SetAttribute("process_id", 12347);
+    record->SetAttribute("thread_id", 12348);
+    fixture.logger->EmitLogRecord(std::move(record));
+  }
+
+  ReportCounters(state, fixture, severity, 14 + 2 * sizeof(int));
+}
+BENCHMARK(BM_LogBySeverity)
+    ->Arg(static_cast<int64_t>(Severity::kTrace))
+    ->Arg(static_cast<int64_t>(Severity::kInfo))
+    ->Arg(static_cast<int64_t>(Severity::kError))
+    ->ArgName("severity");
+
+// Runs on 1 to N threads. Arg 0: processor (0 = simple, 1 = batch).
+static void BM_LogThreads(benchmark::State &state)
+{
+  auto &fixture = GetLoggerFixture(static_cast<ProcessorKind>(state.range(0)));
+
+  const EventId event_id{0x12345678, "Company.Component.SubComponent.FunctionName"};
+  for (auto _ : state)
+  {
+    fixture.logger->Info(
+        event_id, "Simulate function enter trace message from {process_id}:{thread_id}",
+        opentelemetry::common::MakeAttributes({{"process_id", 12347}, {"thread_id", 12348}}));
+  }
+
+  ReportCounters(state, fixture, Severity::kInfo, 67 + 2 * sizeof(int));
+}
+BENCHMARK(BM_LogThreads)
+    ->Arg(static_cast<int64_t>(ProcessorKind::kSimple))
+    ->Arg(static_cast<int64_t>(ProcessorKind::kBatch))
+    ->ArgName("batch")
+    ->ThreadRange(1, static_cast<int>(std::thread::hardware_concurrency()))
+    ->UseRealTime();
+
+// Arg 0: number of metrics, each with 8 sum points.
+static void BM_MetricsExport(benchmark::State &state)
+{
+  namespace metrics_sdk         = opentelemetry::sdk::metrics;
+  namespace user_events_metrics = opentelemetry::exporter::user_events::metrics;
+
+  user_events_metrics::Exporter exporter;
+  if (!exporter.IsEnabled())
+  {
+    // Export returns right away, the timings would not measure the encoding.
+    state.SkipWithError("otlp_metrics tracepoint is not enabled");
+    return;
+  }
+
+  auto resource = opentelemetry::sdk::resource::Resource::Create({});
+  auto scope    = opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create(
+      "UserEventsBenchmark");
+
+  metrics_sdk::ScopeMetrics scope_metrics;
+  scope_metrics.scope_ = scope.get();
+  for (int64_t i = 0; i < state.range(0); i++)
+  {
+    metrics_sdk::MetricData metric;
+    metric.instrument_descriptor = {"metric_" + std::to_string(i), "description", "unit",
+                                    metrics_sdk::InstrumentType::kCounter,
+                                    metrics_sdk::InstrumentValueType::kLong};
+    metric.aggregation_temporality = metrics_sdk::AggregationTemporality::kDelta;
+    metric.start_ts                = std::chrono::system_clock::now();
+    metric.end_ts                  = std::chrono::system_clock::now();
+    for (int point = 0; point < 8; point++)
+    {
+      metrics_sdk::SumPointData sum;
+      sum.value_ = static_cast<int64_t>(point);
+      metrics_sdk::PointDataAttributes point_data;
+      point_data.attributes = {{"point", point}};
+      point_data.point_data = sum;
+      metric.point_data_attr_.push_back(point_data);
+    }
+    scope_metrics.metric_data_.push_back(metric);
+  }
+
+  metrics_sdk::ResourceMetrics data;
+  data.resource_ = &resource;
+  data.scope_metric_data_.push_back(scope_metrics);
+
+  // Size of the serialized request written to the tracepoint, chunking aside.
+  opentelemetry::proto::collector::metrics::v1::ExportMetricsServiceRequest request;
+  opentelemetry::exporter::otlp::OtlpMetricUtils::PopulateRequest(data, &request);
+  const size_t bytes_per_op = request.ByteSizeLong();
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(exporter.Export(data));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes_per_op));
+  state.counters["bytes_per_op"] = static_cast<double>(bytes_per_op);
+}
+BENCHMARK(BM_MetricsExport)->RangeMultiplier(8)->Range(1, 4096)->ArgName("metrics");
+
 }  // namespace
 
 int main(int argc, char **argv)
@@ -0,0 +1,76 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include "opentelemetry/exporters/user_events/logs/exporter.h"
+#include "opentelemetry/exporters/user_events/trace/exporter.h"
+#include "opentelemetry/logs/provider.h"
+#include "opentelemetry/sdk/logs/logger_provider_factory.h"
+#include "opentelemetry/sdk/logs/simple_log_record_processor_factory.h"
+#include "opentelemetry/sdk/trace/simple_processor_factory.h"
+#include "opentelemetry/sdk/trace/tracer_provider_factory.h"
+#include "opentelemetry/trace/provider.h"
+
+#include <chrono>
+#include <thread>
+
+namespace logs_api          = opentelemetry::logs;
+namespace logs_sdk          = opentelemetry::sdk::logs;
+namespace trace_api         = opentelemetry::trace;
+namespace trace_sdk         = opentelemetry::sdk::trace;
+namespace user_events_logs  = opentelemetry::exporter::user_events::logs;
+namespace user_events_trace = opentelemetry::exporter::user_events::trace;
+
+namespace
+{
+
+void InitTracer()
+{
+  // Create user_events span exporter instance
+  auto exporter_options = user_events_trace::ExporterOptions();
+  auto exporter         = std::unique_ptr<user_events_trace::Exporter>(
+      new user_events_trace::Exporter(exporter_options));
+  auto processor = trace_sdk::SimpleSpanProcessorFactory::Create(std::move(exporter));
+  std::shared_ptr<trace_api::TracerProvider> provider(
+      trace_sdk::TracerProviderFactory::Create(std::move(processor)));
+
+  // Set the global tracer provider
+  trace_api::Provider::SetTracerProvider(provider);
+}
+
+void InitLogger()
+{
+  // Logs emitted inside a span carry its trace and span ids
+  auto exporter_options = user_events_logs::ExporterOptions();
+  auto exporter =
+      std::unique_ptr<user_events_logs::Exporter>(new user_events_logs::Exporter(exporter_options));
+  auto processor = logs_sdk::SimpleLogRecordProcessorFactory::Create(std::move(exporter));
+  std::shared_ptr<logs_api::LoggerProvider> provider(
+      logs_sdk::LoggerProviderFactory::Create(std::move(processor)));
+
+  // Set the global logger provider
+  logs_api::Provider::SetLoggerProvider(provider);
+}
+
+}  // namespace
+
+int main()
+{
+  InitTracer();
+  InitLogger();
+
+  auto tracer = trace_api::Provider::GetTracerProvider()->GetTracer("fruit_selling");
+  auto logger = logs_api::Provider::GetLoggerProvider()->GetLogger("fruit_selling");
+
+  while (true)
+  {
+    auto span  = tracer->StartSpan("SellFruit", {{"fruit_name", "apple"}});
+    auto scope = tracer->WithActiveSpan(span);
+
+    logger->Info("Selling fruit {fruit_name}",
+                 opentelemetry::common::MakeAttributes({{"fruit_name", "apple"}}));
+
+    span->End();
+
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+  }
+}
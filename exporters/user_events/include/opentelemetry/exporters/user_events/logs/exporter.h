@@ -5,11 +5,18 @@
 
 #include "exporter_options.h"
 #include "opentelemetry/common/spin_lock_mutex.h"
+#include "opentelemetry/logs/severity.h"
 #include "opentelemetry/sdk/logs/exporter.h"
+#include "recordable.h"
 
 #include <eventheader/EventHeaderDynamic.h>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 OPENTELEMETRY_BEGIN_NAMESPACE
 namespace exporter
@@ -29,6 +36,8 @@ class Exporter final : public opentelemetry::sdk::logs::LogRecordExporter
 public:
   explicit Exporter(const ExporterOptions &options) noexcept;
 
+  ~Exporter() override;
+
   /**
    * Exports a span of logs sent from the processor.
    */
@@ -42,18 +51,69 @@ class Exporter final : public opentelemetry::sdk::logs::LogRecordExporter
   bool Shutdown(
       std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override;
 
+  /**
+   * Wait until every event handed to the writer thread has been written.
+   */
   bool ForceFlush(
-      std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override {
-        // TODO: implement forceflush
-        return true;
-      }
+      std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override;
 
   bool isShutdown() const noexcept;
 
+  /**
+   * Check whether a listener is attached to the tracepoint of the given severity. Callers may
+   * use it to avoid creating log records that would be dropped anyway.
+   */
+  bool IsEnabled(opentelemetry::logs::Severity severity) const noexcept;
+
+  /**
+   * Check whether a listener is attached to the tracepoint of the given severity for an event
+   * name configured in ExporterOptions::event_keywords.
+   */
+  bool IsEnabled(opentelemetry::logs::Severity severity,
+                 nostd::string_view event_name) const noexcept;
+
+  /**
+   * Number of events dropped because the writer thread queue was full.
+   */
+  size_t GetDroppedCount() const noexcept { return dropped_count_.load(); }
+
 private:
+  /**
+   * friend class for testing
+   */
+  friend class ExporterTestPeer;
+
+  /**
+   * Hand prepared records to the writer thread. Records beyond max_queue_size are dropped.
+   */
+  opentelemetry::sdk::common::ExportResult Enqueue(
+      std::vector<std::unique_ptr<Recordable>> &pending) noexcept;
+
+  int WriteRecord(Recordable &record) noexcept;
+
+  void Recycle(std::unique_ptr<Recordable> &&recordable) noexcept;
+
+  void WriterThread() noexcept;
+
+  void StopWriterThread() noexcept;
+
   const ExporterOptions options_;
   bool is_shutdown_ = false;
   mutable opentelemetry::common::SpinLockMutex lock_;
+
+  // Writer thread state, only used with ExporterOptions::use_writer_thread.
+  std::mutex queue_lock_;
+  std::condition_variable queue_cv_;
+  std::condition_variable drained_cv_;
+  std::vector<std::unique_ptr<Recordable>> queue_;
+  bool writer_busy_ = false;
+  bool stop_writer_ = false;
+  std::atomic<size_t> dropped_count_{0};
+  std::thread writer_;
+
+  // Exported recordables kept for reuse, only used with ExporterOptions::recordable_pool_size.
+  opentelemetry::common::SpinLockMutex pool_lock_;
+  std::vector<std::unique_ptr<Recordable>> recordable_pool_;
   
   const std::array<event_level, 6> event_levels_map = {
     static_cast<event_level>(6),
@@ -65,7 +125,7 @@ class Exporter final : public opentelemetry::sdk::logs::LogRecordExporter
   };
 
   ehd::Provider provider_;
-  std::array<std::shared_ptr<const ehd::EventSet>, 6> event_set_levels_;
+  std::shared_ptr<const EventSetRegistry> event_sets_;
 };  // class Exporter
 
 }  // namespace logs
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <map>
 #include <string>
 #include "opentelemetry/version.h"
 
@@ -39,6 +42,28 @@ struct ExporterOptions
 
 public:
     std::string provider_name;
+
+    // Hand prepared events to a dedicated writer thread, so the exporting thread only pays for
+    // encoding. Every event still costs one write to the user_events data file: the kernel ABI
+    // has no way to submit several events in a single call.
+    bool use_writer_thread = false;
+
+    // Maximum number of events waiting for the writer thread. Events beyond are dropped.
+    size_t max_queue_size = 2048;
+
+    // Number of exported recordables kept for reuse by MakeRecordable. Reused recordables keep
+    // the buffers of their event builder, which avoids allocations on the hot path. 0 disables
+    // the pool.
+    size_t recordable_pool_size = 0;
+
+    // Keyword of the events not listed in event_keywords.
+    uint64_t default_keyword = 1;
+
+    // Event names (as passed with the EventId) written to tracepoints of their own keyword.
+    // Listeners may then enable only the events they care about, e.g. the tracepoint
+    // `<provider_name>_L4K10` for warnings of the events mapped to keyword 0x10. Records of an
+    // event without listener are not encoded. Events sharing a keyword share tracepoints.
+    std::map<std::string, uint64_t> event_keywords;
 };
 
 }  // namespace logs
@@ -8,11 +8,19 @@
 #include "opentelemetry/nostd/string_view.h"
 #include "opentelemetry/sdk/common/attribute_utils.h"
 #include "opentelemetry/sdk/logs/recordable.h"
+#include "opentelemetry/trace/span_id.h"
+#include "opentelemetry/trace/trace_id.h"
 #include "opentelemetry/version.h"
 #include "utils.h"
 
 #include <eventheader/EventHeaderDynamic.h>
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 OPENTELEMETRY_BEGIN_NAMESPACE
 namespace exporter
@@ -22,6 +30,93 @@ namespace user_events
 namespace logs
 {
 
+/**
+ * Event sets registered by the exporter, one per severity level.
+ */
+using EventSetLevels = std::array<std::shared_ptr<const ehd::EventSet>, 6>;
+
+/**
+ * Event sets of an exporter: the default levels used by every event, and the levels of the
+ * event names configured with their own keyword. The registry is filled by the exporter
+ * constructor and read-only afterwards, so recordables look up their event sets without
+ * locking.
+ */
+class EventSetRegistry
+{
+public:
+  explicit EventSetRegistry(const EventSetLevels &default_levels) noexcept
+      : default_levels_(default_levels)
+  {}
+
+  /**
+   * Route an event name to its own event sets. Only called while the exporter is constructed.
+   */
+  void Add(const std::string &event_name, std::shared_ptr<const EventSetLevels> levels)
+  {
+    auto it = std::lower_bound(named_levels_.begin(), named_levels_.end(),
+                               nostd::string_view(event_name), Less);
+    if (it != named_levels_.end() && it->first == event_name)
+    {
+      it->second = std::move(levels);
+      return;
+    }
+    named_levels_.insert(it, std::make_pair(event_name, std::move(levels)));
+  }
+
+  const EventSetLevels &GetDefault() const noexcept { return default_levels_; }
+
+  /**
+   * Event sets of the given event name, or the default ones when the name is not configured.
+   * Binary search over the names compared as string views, so no string is allocated.
+   */
+  const EventSetLevels &Find(nostd::string_view event_name) const noexcept
+  {
+    if (named_levels_.empty())
+    {
+      return default_levels_;
+    }
+    auto it = std::lower_bound(named_levels_.begin(), named_levels_.end(), event_name, Less);
+    if (it != named_levels_.end() && nostd::string_view(it->first) == event_name)
+    {
+      return *it->second;
+    }
+    return default_levels_;
+  }
+
+  /**
+   * Whether a listener is attached to the given level of the default event sets or of any
+   * configured event name. Records are encoded under this condition until their event name is
+   * known, so setting the event id after the body does not lose the body.
+   */
+  bool AnyEnabled(int level_index) const noexcept
+  {
+    if (default_levels_[level_index]->Enabled())
+    {
+      return true;
+    }
+    for (const auto &entry : named_levels_)
+    {
+      if ((*entry.second)[level_index]->Enabled())
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  using NamedLevels = std::pair<std::string, std::shared_ptr<const EventSetLevels>>;
+
+  static bool Less(const NamedLevels &entry, nostd::string_view event_name) noexcept
+  {
+    return nostd::string_view(entry.first).compare(event_name) < 0;
+  }
+
+  EventSetLevels default_levels_;
+  // Sorted by event name.
+  std::vector<NamedLevels> named_levels_;
+};
+
 class Recordable final : public opentelemetry::sdk::logs::Recordable
 {
 public:
@@ -29,13 +124,37 @@ class Recordable final : public opentelemetry::sdk::logs::Recordable
 
   int GetLevelIndex() noexcept { return level_index_; }
 
+  /**
+   * Event set this record is written to, selected by its event name and severity. Only valid
+   * for recordables created with an event set registry.
+   */
+  const ehd::EventSet &GetEventSet() const noexcept { return *(*levels_)[level_index_]; }
+
+  /**
+   * Whether a listener is attached to the tracepoint of this record's level. When it is not,
+   * body and attributes are not encoded at all.
+   */
+  bool IsEnabled() const noexcept { return enabled_; }
+
   bool PrepareExport() noexcept;
 
+  /**
+   * Clear all fields so the recordable can be reused. The event builder keeps its buffers.
+   */
+  void Reset() noexcept;
+
   /**
    * Construct a new Recordable object
    *
    */
   Recordable() noexcept;
+
+  /**
+   * Construct a new Recordable object which checks the tracepoint enablement of its level as
+   * soon as the severity and event name are known.
+   * @param event_sets the event sets registered by the exporter
+   */
+  explicit Recordable(std::shared_ptr<const EventSetRegistry> event_sets) noexcept;
   /**
    * Set the severity for this log.
    * @param severity the severity of the event
@@ -55,7 +174,8 @@ class Recordable final : public opentelemetry::sdk::logs::Recordable
   void SetBody(const opentelemetry::common::AttributeValue &message) noexcept override;
 
   /**
-   * Set event id for this log.
+   * Set event id for this log. The name selects the event sets of the record; the id and name
+   * are only written when set before the body.
    * @param id the id to set
    * @param name the name to set
    */
@@ -77,7 +197,8 @@ class Recordable final : public opentelemetry::sdk::logs::Recordable
                     const opentelemetry::common::AttributeValue &value) noexcept override;
 
   /**
-   * Set trace id for this log.
+   * Set trace id for this log. Trace and span ids are written to Part A, so they must be set
+   * before the body (the SDK sets them when the record is created).
    * @param trace_id the trace id to set
    */
   void SetTraceId(const opentelemetry::trace::TraceId &trace_id) noexcept override;
@@ -117,6 +238,10 @@ class Recordable final : public opentelemetry::sdk::logs::Recordable
 
 private:
   ehd::EventBuilder event_builder_;
+  std::shared_ptr<const EventSetRegistry> event_sets_;
+  const EventSetLevels *levels_ = nullptr;
+  opentelemetry::trace::TraceId trace_id_;
+  opentelemetry::trace::SpanId span_id_;
   int64_t event_id_ = 0;
   nostd::string_view event_name_;
   int level_index_                = 0;
@@ -126,6 +251,7 @@ class Recordable final : public opentelemetry::sdk::logs::Recordable
   size_t cs_part_c_bookmark_size_ = 0;
   uint8_t severity_               = 0;
   bool has_event_id_              = false;
+  bool enabled_                   = true;
 };
 
 }  // namespace logs
@@ -3,10 +3,14 @@
 
 #pragma once
 
+#include "opentelemetry/nostd/span.h"
 #include "opentelemetry/sdk/common/attribute_utils.h"
 #include "opentelemetry/version.h"
 
 #include <eventheader/EventHeaderDynamic.h>
+#include <iterator>
+#include <string>
+#include <string_view>
 
 OPENTELEMETRY_BEGIN_NAMESPACE
 namespace exporter
@@ -22,6 +26,128 @@ void PopulateAttribute(nostd::string_view key,
                        const api_common::AttributeValue &value,
                        ehd::EventBuilder &event_builder) noexcept;
 
+void PopulateOwnedAttribute(nostd::string_view key,
+                            const opentelemetry::sdk::common::OwnedAttributeValue &value,
+                            ehd::EventBuilder &event_builder) noexcept;
+
+/**
+ * Add a fixed size binary field, e.g. a trace or span id.
+ */
+void PopulateBinary(nostd::string_view key,
+                    nostd::span<const uint8_t> value,
+                    ehd::EventBuilder &event_builder) noexcept;
+
+//
+// Iterator which convers "nostd::string_view *" or "std::string *" to "std::string_view *".
+// This is needed to pass a span of strings to EventBuilder::AddStringRange.
+//
+template <class T>
+struct StringViewIterator
+{
+  const T *m_ptr;
+  explicit StringViewIterator(const T *ptr) noexcept : m_ptr(ptr) {}
+  bool operator==(StringViewIterator other) const noexcept { return m_ptr == other.m_ptr; }
+  bool operator!=(StringViewIterator other) const noexcept { return m_ptr != other.m_ptr; }
+  const std::string_view operator*() const noexcept
+  {
+    return std::string_view(m_ptr->data(), m_ptr->size());
+  }
+  StringViewIterator &operator++() noexcept
+  {
+    m_ptr += 1;
+    return *this;
+  }
+};
+
+/**
+ * Attribute sink writing EventHeader fields. Numeric arrays are handed to the builder as
+ * contiguous pointer ranges so they are copied in bulk. Besides attributes it writes the
+ * binary ids and the structs of the span events.
+ */
+class EventBuilderSink
+{
+public:
+  explicit EventBuilderSink(ehd::EventBuilder &event_builder) noexcept
+      : event_builder_(event_builder)
+  {}
+
+  void AddScalar(nostd::string_view key, bool value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_boolean);
+  }
+
+  void AddScalar(nostd::string_view key, uint8_t value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_default);
+  }
+
+  void AddScalar(nostd::string_view key, int value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_signed_int);
+  }
+
+  void AddScalar(nostd::string_view key, int64_t value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_signed_int);
+  }
+
+  void AddScalar(nostd::string_view key, unsigned int value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_default);
+  }
+
+  void AddScalar(nostd::string_view key, uint64_t value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_default);
+  }
+
+  void AddScalar(nostd::string_view key, double value)
+  {
+    event_builder_.AddValue(key.data(), value, event_field_format_float);
+  }
+
+  void AddString(nostd::string_view key, nostd::string_view value)
+  {
+    event_builder_.AddString<char>(key.data(), std::string_view(value.data(), value.size()),
+                                   event_field_format_default);
+  }
+
+  void AddBinary(nostd::string_view key, nostd::span<const uint8_t> value)
+  {
+    PopulateBinary(key, value, event_builder_);
+  }
+
+  void BeginStruct(nostd::string_view name, uint8_t field_count)
+  {
+    event_builder_.AddStruct(name.data(), field_count);
+  }
+
+  template <class It>
+  void AddArray(nostd::string_view key, It first, It last)
+  {
+    using T = typename std::iterator_traits<It>::value_type;
+    event_builder_.AddValueRange(key.data(), first, last, Format(static_cast<T>(0)));
+  }
+
+  template <class T>
+  void AddStringArray(nostd::string_view key, const T *first, const T *last)
+  {
+    event_builder_.AddStringRange<char>(key.data(), StringViewIterator<T>(first),
+                                        StringViewIterator<T>(last), event_field_format_default);
+  }
+
+private:
+  static event_field_format Format(bool) noexcept { return event_field_format_boolean; }
+  static event_field_format Format(int) noexcept { return event_field_format_signed_int; }
+  static event_field_format Format(int64_t) noexcept { return event_field_format_signed_int; }
+  static event_field_format Format(double) noexcept { return event_field_format_float; }
+  static event_field_format Format(uint8_t) noexcept { return event_field_format_default; }
+  static event_field_format Format(unsigned int) noexcept { return event_field_format_default; }
+  static event_field_format Format(uint64_t) noexcept { return event_field_format_default; }
+
+  ehd::EventBuilder &event_builder_;
+};
+
 }  // namespace utils
 }  // namespace user_events
 }  // namespace exporter
@@ -4,15 +4,22 @@
 #pragma once
 
 #include "opentelemetry/exporters/otlp/otlp_metric_utils.h"
+#include "opentelemetry/proto/collector/metrics/v1/metrics_service.pb.h"
 
 #include "exporter_options.h"
 #include "opentelemetry/sdk/metrics/push_metric_exporter.h"
 
 #include "opentelemetry/common/spin_lock_mutex.h"
+#include "opentelemetry/nostd/function_ref.h"
 #include "opentelemetry/sdk/common/global_log_handler.h"
 
+#include <google/protobuf/arena.h>
 #include <tracepoint/tracepoint.h>
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 OPENTELEMETRY_BEGIN_NAMESPACE
 namespace exporter
 {
@@ -49,6 +56,17 @@ class Exporter final : public opentelemetry::sdk::metrics::PushMetricExporter
   sdk_common::ExportResult Export(
     const sdk_metrics::ResourceMetrics &data) noexcept override;
 
+  /**
+   * Check whether a listener is attached to the otlp_metrics tracepoint. Export does nothing
+   * when it is not.
+   */
+  bool IsEnabled() const noexcept;
+
+  /**
+   * Get the number of data points dropped because they did not fit into max_event_size.
+   */
+  size_t GetDroppedCount() const noexcept { return dropped_count_.load(); }
+
   bool ForceFlush(
     std::chrono::microseconds timeout = std::chrono::microseconds::max()) noexcept override;
 
@@ -56,6 +74,30 @@ class Exporter final : public opentelemetry::sdk::metrics::PushMetricExporter
     std::chrono::microseconds timeout = std::chrono::microseconds::max()) noexcept override;
 
   private:
+    sdk_common::ExportResult WriteRequest(
+      const proto::collector::metrics::v1::ExportMetricsServiceRequest &request) noexcept;
+
+    sdk_common::ExportResult WriteChunked(
+      const proto::collector::metrics::v1::ExportMetricsServiceRequest &request,
+      google::protobuf::Arena &arena) noexcept;
+
+    /**
+     * Split a request into chunks of at most `limit` bytes, including the size prefix, and pass
+     * each to `write`. Metrics above the limit are split by data point. Returns the number of
+     * data points that do not fit on their own and were dropped.
+     */
+    static size_t SplitRequest(
+      const proto::collector::metrics::v1::ExportMetricsServiceRequest &request,
+      size_t limit,
+      google::protobuf::Arena &arena,
+      nostd::function_ref<void(const proto::collector::metrics::v1::ExportMetricsServiceRequest &)>
+          write) noexcept;
+
+    /**
+     * friend class for testing
+     */
+    friend class ExporterTestPeer;
+
     // The configration options associated with this exporter.
     const ExporterOptions options_;
     mutable opentelemetry::common::SpinLockMutex lock_;
@@ -68,6 +110,12 @@ class Exporter final : public opentelemetry::sdk::metrics::PushMetricExporter
     tracepoint_provider_state provider_ = TRACEPOINT_PROVIDER_STATE_INIT;
     tracepoint_state otlp_metrics_ = TRACEPOINT_STATE_INIT;
 
+    // Serialization state reused across exports. Both buffers only grow.
+    std::mutex export_lock_;
+    std::vector<char> arena_block_;
+    std::vector<char> buffer_;
+
+    std::atomic<size_t> dropped_count_{0};
 };
 
 }  // namespace metrics
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 #include "opentelemetry/version.h"
@@ -17,10 +18,17 @@ namespace metrics
 
 namespace sdk_metrics = opentelemetry::sdk::metrics;
 
+// perf sample records carry a 16 bit size, so events above 64 KiB cannot be collected.
+const size_t kDefaultUserEventsMaxEventSize = 63 * 1024;
+
 struct ExporterOptions
 {
   opentelemetry::exporter::otlp::PreferredAggregationTemporality aggregation_temporality =
       opentelemetry::exporter::otlp::PreferredAggregationTemporality::kCumulative;
+
+  // Requests larger than this are split into several events, each holding a subset of the
+  // metrics or of the data points of a larger metric. A data point larger than this is dropped.
+  size_t max_event_size = kDefaultUserEventsMaxEventSize;
 };
 
 }  // namespace metrics
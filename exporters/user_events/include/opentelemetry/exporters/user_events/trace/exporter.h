@@ -0,0 +1,64 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "exporter_options.h"
+#include "opentelemetry/common/spin_lock_mutex.h"
+#include "opentelemetry/sdk/trace/exporter.h"
+
+#include <eventheader/EventHeaderDynamic.h>
+#include <memory>
+#include <mutex>
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace trace
+{
+
+namespace sdk_trace = opentelemetry::sdk::trace;
+
+/**
+ * The user_events trace exporter exports spans to tracepoint via user_events.
+ */
+class Exporter final : public opentelemetry::sdk::trace::SpanExporter
+{
+public:
+  explicit Exporter(const ExporterOptions &options) noexcept;
+
+  std::unique_ptr<sdk_trace::Recordable> MakeRecordable() noexcept override;
+
+  /**
+   * Exports a span of spans sent from the processor.
+   */
+  opentelemetry::sdk::common::ExportResult Export(
+      const opentelemetry::nostd::span<std::unique_ptr<sdk_trace::Recordable>> &spans) noexcept
+      override;
+
+  bool ForceFlush(
+      std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override
+  {
+    return true;
+  }
+
+  bool Shutdown(
+      std::chrono::microseconds timeout = (std::chrono::microseconds::max)()) noexcept override;
+
+  bool isShutdown() const noexcept;
+
+private:
+  const ExporterOptions options_;
+  bool is_shutdown_ = false;
+  mutable opentelemetry::common::SpinLockMutex lock_;
+
+  ehd::Provider provider_;
+  std::shared_ptr<const ehd::EventSet> event_set_;
+};  // class Exporter
+
+}  // namespace trace
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
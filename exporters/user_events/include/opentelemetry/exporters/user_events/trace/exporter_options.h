@@ -0,0 +1,47 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <string>
+#include "opentelemetry/version.h"
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace trace
+{
+
+const std::string kDefaultUserEventsTraceProviderName = "opentelemetry_traces";
+
+/**
+ * Struct to hold the options needed for the user_events trace exporter.
+ */
+
+struct ExporterOptions
+{
+public:
+    ExporterOptions() : ExporterOptions(kDefaultUserEventsTraceProviderName) {}
+
+    ExporterOptions(std::string provider_name)
+    {
+        if (provider_name.empty())
+        {
+            this->provider_name = kDefaultUserEventsTraceProviderName;
+        }
+        else
+        {
+            this->provider_name = provider_name;
+        }
+    }
+
+public:
+    std::string provider_name;
+};
+
+}  // namespace trace
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
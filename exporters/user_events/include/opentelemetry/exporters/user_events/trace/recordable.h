@@ -0,0 +1,158 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "opentelemetry/common/timestamp.h"
+#include "opentelemetry/exporters/encoding/attribute_encoder.h"
+#include "opentelemetry/nostd/string_view.h"
+#include "opentelemetry/sdk/common/attribute_utils.h"
+#include "opentelemetry/sdk/trace/recordable.h"
+#include "opentelemetry/trace/span_id.h"
+#include "opentelemetry/trace/trace_id.h"
+#include "opentelemetry/version.h"
+
+#include <eventheader/EventHeaderDynamic.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace trace
+{
+
+/**
+ * Span recordable encoded as a Common Schema event: trace and span ids go to Part A, span
+ * fields to Part B and attributes to Part C. Span fields arrive in any order while the span is
+ * alive, so the event is only built by PrepareExport.
+ */
+class Recordable final : public opentelemetry::sdk::trace::Recordable
+{
+public:
+  /**
+   * Construct a new Recordable object. When no listener is attached to the event set, span
+   * data is not retained.
+   * @param event_set the event set spans are written to
+   */
+  explicit Recordable(std::shared_ptr<const ehd::EventSet> event_set) noexcept;
+
+  ehd::EventBuilder &GetEventBuilder() noexcept { return event_builder_; }
+
+  bool IsEnabled() const noexcept { return enabled_; }
+
+  bool PrepareExport() noexcept;
+
+  /**
+   * Write Part A, Part B and Part C of the span to sink, in event order. PrepareExport passes a
+   * utils::EventBuilderSink; a sink also provides BeginStruct(name, field_count) and
+   * AddBinary(key, bytes) besides the attribute sink functions.
+   */
+  template <class Sink>
+  void EncodeFields(Sink &sink) const;
+
+  void SetIdentity(const opentelemetry::trace::SpanContext &span_context,
+                   opentelemetry::trace::SpanId parent_span_id) noexcept override;
+
+  void SetAttribute(nostd::string_view key,
+                    const opentelemetry::common::AttributeValue &value) noexcept override;
+
+  void AddEvent(nostd::string_view name,
+                opentelemetry::common::SystemTimestamp timestamp,
+                const opentelemetry::common::KeyValueIterable &attributes) noexcept override
+  {}  // Not Supported
+
+  void AddLink(const opentelemetry::trace::SpanContext &span_context,
+               const opentelemetry::common::KeyValueIterable &attributes) noexcept override
+  {}  // Not Supported
+
+  void SetStatus(opentelemetry::trace::StatusCode code,
+                 nostd::string_view description) noexcept override;
+
+  void SetName(nostd::string_view name) noexcept override;
+
+  void SetTraceFlags(opentelemetry::trace::TraceFlags flags) noexcept override {}
+
+  void SetSpanKind(opentelemetry::trace::SpanKind span_kind) noexcept override;
+
+  void SetResource(const opentelemetry::sdk::resource::Resource &resource) noexcept override {
+  }  // Not Supported
+
+  void SetStartTime(opentelemetry::common::SystemTimestamp start_time) noexcept override;
+
+  void SetDuration(std::chrono::nanoseconds duration) noexcept override;
+
+  void SetInstrumentationScope(const opentelemetry::sdk::instrumentationscope::InstrumentationScope
+                                   &instrumentation_scope) noexcept override
+  {}  // Not Supported
+
+private:
+  // EventHeader structs hold at most 127 fields.
+  static constexpr size_t kMaxStructFieldCount = 127;
+
+  ehd::EventBuilder event_builder_;
+  bool enabled_ = true;
+
+  opentelemetry::trace::TraceId trace_id_;
+  opentelemetry::trace::SpanId span_id_;
+  opentelemetry::trace::SpanId parent_span_id_;
+  std::string name_;
+  opentelemetry::trace::SpanKind span_kind_ = opentelemetry::trace::SpanKind::kInternal;
+  opentelemetry::trace::StatusCode status_code_ = opentelemetry::trace::StatusCode::kUnset;
+  std::string status_description_;
+  opentelemetry::common::SystemTimestamp start_time_;
+  std::chrono::nanoseconds duration_{0};
+  opentelemetry::sdk::common::AttributeMap attributes_;
+};
+
+template <class Sink>
+void Recordable::EncodeFields(Sink &sink) const
+{
+  sink.BeginStruct("PartA", 2);
+  sink.AddBinary("ext_dt_traceId", trace_id_.Id());
+  sink.AddBinary("ext_dt_spanId", span_id_.Id());
+
+  const bool has_parent  = parent_span_id_.IsValid();
+  const bool has_message = status_code_ == opentelemetry::trace::StatusCode::kError &&
+                           !status_description_.empty();
+  const uint64_t start_time = static_cast<uint64_t>(start_time_.time_since_epoch().count());
+
+  sink.BeginStruct("PartB", static_cast<uint8_t>(6 + (has_parent ? 1 : 0) + (has_message ? 1 : 0)));
+  sink.AddString("_typeName", "Span");
+  sink.AddString("name", name_);
+  sink.AddScalar("kind", static_cast<uint8_t>(span_kind_));
+  sink.AddScalar("startTime", start_time);
+  sink.AddScalar("endTime", start_time + static_cast<uint64_t>(duration_.count()));
+  sink.AddScalar("success", status_code_ != opentelemetry::trace::StatusCode::kError);
+  if (has_parent)
+  {
+    sink.AddBinary("parentId", parent_span_id_.Id());
+  }
+  if (has_message)
+  {
+    sink.AddString("statusMessage", status_description_);
+  }
+
+  if (!attributes_.empty())
+  {
+    size_t count = (std::min)(attributes_.size(), static_cast<size_t>(kMaxStructFieldCount));
+    sink.BeginStruct("PartC", static_cast<uint8_t>(count));
+    for (const auto &attribute : attributes_)
+    {
+      if (count-- == 0)
+      {
+        break;
+      }
+      encoding::EncodeAttribute(sink, attribute.first, attribute.second);
+    }
+  }
+}
+
+}  // namespace trace
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
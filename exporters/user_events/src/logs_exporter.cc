@@ -5,6 +5,8 @@
 #include "opentelemetry/exporters/user_events/logs/recordable.h"
 #include "opentelemetry/sdk_config.h"
 
+#include <map>
+
 namespace nostd     = opentelemetry::nostd;
 namespace sdklogs   = opentelemetry::sdk::logs;
 namespace sdkcommon = opentelemetry::sdk::common;
@@ -23,17 +25,78 @@ Exporter::Exporter(const ExporterOptions &options) noexcept
     : options_(options), provider_(options.provider_name)
 {
   // Initialize the event sets
-  for (int i = 0; i < sizeof(event_levels_map) / sizeof(event_levels_map[0]); i++)
+  auto register_levels = [this](uint64_t keyword) {
+    std::shared_ptr<EventSetLevels> levels(new EventSetLevels());
+    for (size_t i = 0; i < event_levels_map.size(); i++)
+    {
+      (*levels)[i] = provider_.RegisterSet(event_levels_map[i], keyword);
+    }
+    return levels;
+  };
+
+  std::shared_ptr<EventSetRegistry> event_sets(
+      new EventSetRegistry(*register_levels(options_.default_keyword)));
+
+  // Events configured with the same keyword share their event sets.
+  std::map<uint64_t, std::shared_ptr<const EventSetLevels>> keyword_levels;
+  for (const auto &event_keyword : options_.event_keywords)
   {
-    event_set_levels_[i] = provider_.RegisterSet(event_levels_map[i], 1);
+    auto &levels = keyword_levels[event_keyword.second];
+    if (levels == nullptr)
+    {
+      levels = register_levels(event_keyword.second);
+    }
+    event_sets->Add(event_keyword.first, levels);
+  }
+  event_sets_ = std::move(event_sets);
+
+  recordable_pool_.reserve(options_.recordable_pool_size);
+
+  if (options_.use_writer_thread)
+  {
+    queue_.reserve(options_.max_queue_size);
+    writer_ = std::thread(&Exporter::WriterThread, this);
   }
 }
 
+Exporter::~Exporter()
+{
+  StopWriterThread();
+}
+
 /*********************** Exporter methods ***********************/
 
 std::unique_ptr<sdk_logs::Recordable> Exporter::MakeRecordable() noexcept
 {
-  return std::unique_ptr<Recordable>(new Recordable());
+  if (options_.recordable_pool_size > 0)
+  {
+    const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(pool_lock_);
+    if (!recordable_pool_.empty())
+    {
+      std::unique_ptr<Recordable> recordable = std::move(recordable_pool_.back());
+      recordable_pool_.pop_back();
+      return recordable;
+    }
+  }
+
+  return std::unique_ptr<Recordable>(new Recordable(event_sets_));
+}
+
+void Exporter::Recycle(std::unique_ptr<Recordable> &&recordable) noexcept
+{
+  if (options_.recordable_pool_size == 0 || recordable == nullptr)
+  {
+    return;
+  }
+
+  // Reset outside the lock, the event builder keeps its buffer capacity.
+  recordable->Reset();
+
+  const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(pool_lock_);
+  if (recordable_pool_.size() < options_.recordable_pool_size)
+  {
+    recordable_pool_.push_back(std::move(recordable));
+  }
 }
 
 sdk::common::ExportResult Exporter::Export(
@@ -46,32 +109,34 @@ sdk::common::ExportResult Exporter::Export(
     return sdk::common::ExportResult::kFailure;
   }
 
-  int err;
+  std::vector<std::unique_ptr<Recordable>> pending;
 
   for (auto &record : records)
   {
     auto user_events_record =
         std::unique_ptr<Recordable>(static_cast<Recordable *>(record.release()));
 
-    if (!user_events_record->PrepareExport())
+    if (!user_events_record->GetEventSet().Enabled())
     {
+      // event_set is not enabled
+      Recycle(std::move(user_events_record));
       continue;
     }
 
-    int level_index = user_events_record->GetLevelIndex();
-
-    auto event_set = event_set_levels_[level_index];
-
-    if (event_set->Enabled())
+    if (!user_events_record->PrepareExport())
     {
-      err = user_events_record->GetEventBuilder().Write(*event_set_levels_[level_index]);
+      Recycle(std::move(user_events_record));
+      continue;
     }
-    else
+
+    if (options_.use_writer_thread)
     {
-      // event_set is not enabled
-      err = 0;
+      pending.push_back(std::move(user_events_record));
+      continue;
     }
 
+    int err = WriteRecord(*user_events_record);
+    Recycle(std::move(user_events_record));
     if (err != 0)
     {
       OTEL_INTERNAL_LOG_ERROR("[user_events Log Exporter] Exporting failed, error code: " << err);
@@ -79,16 +144,151 @@ sdk::common::ExportResult Exporter::Export(
     }
   }
 
+  if (pending.empty())
+  {
+    return sdk::common::ExportResult::kSuccess;
+  }
+
+  return Enqueue(pending);
+}
+
+sdk::common::ExportResult Exporter::Enqueue(
+    std::vector<std::unique_ptr<Recordable>> &pending) noexcept
+{
+  size_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> guard(queue_lock_);
+    size_t space =
+        options_.max_queue_size > queue_.size() ? options_.max_queue_size - queue_.size() : 0;
+    if (pending.size() > space)
+    {
+      dropped = pending.size() - space;
+      pending.resize(space);
+    }
+    for (auto &record : pending)
+    {
+      queue_.push_back(std::move(record));
+    }
+  }
+  queue_cv_.notify_one();
+
+  if (dropped != 0)
+  {
+    dropped_count_ += dropped;
+    OTEL_INTERNAL_LOG_ERROR("[user_events Log Exporter] Writer queue is full, dropped "
+                            << dropped << " log(s)");
+    return sdk::common::ExportResult::kFailureFull;
+  }
+
   return sdk::common::ExportResult::kSuccess;
 }
 
+int Exporter::WriteRecord(Recordable &record) noexcept
+{
+  return record.GetEventBuilder().Write(record.GetEventSet());
+}
+
+void Exporter::WriterThread() noexcept
+{
+  std::vector<std::unique_ptr<Recordable>> batch;
+  batch.reserve(options_.max_queue_size);
+
+  std::unique_lock<std::mutex> guard(queue_lock_);
+  while (true)
+  {
+    queue_cv_.wait(guard, [this] { return stop_writer_ || !queue_.empty(); });
+    if (queue_.empty())
+    {
+      // Stopped and fully drained.
+      break;
+    }
+
+    batch.swap(queue_);
+    writer_busy_ = true;
+    guard.unlock();
+
+    for (auto &record : batch)
+    {
+      int err = WriteRecord(*record);
+      if (err != 0)
+      {
+        OTEL_INTERNAL_LOG_ERROR("[user_events Log Exporter] Writing failed, error code: " << err);
+      }
+      Recycle(std::move(record));
+    }
+    batch.clear();
+
+    guard.lock();
+    writer_busy_ = false;
+    drained_cv_.notify_all();
+  }
+}
+
+void Exporter::StopWriterThread() noexcept
+{
+  if (!writer_.joinable())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(queue_lock_);
+    stop_writer_ = true;
+  }
+  queue_cv_.notify_one();
+  writer_.join();
+}
+
+bool Exporter::ForceFlush(std::chrono::microseconds timeout) noexcept
+{
+  if (!options_.use_writer_thread)
+  {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> guard(queue_lock_);
+  auto drained = [this] { return queue_.empty() && !writer_busy_; };
+  if (timeout == (std::chrono::microseconds::max)())
+  {
+    drained_cv_.wait(guard, drained);
+    return true;
+  }
+  return drained_cv_.wait_for(guard, timeout, drained);
+}
+
 bool Exporter::Shutdown(std::chrono::microseconds) noexcept
 {
-  const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(lock_);
-  is_shutdown_ = true;
+  {
+    const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(lock_);
+    is_shutdown_ = true;
+  }
+
+  // Drain events already handed to the writer thread.
+  StopWriterThread();
   return true;
 }
 
+bool Exporter::IsEnabled(opentelemetry::logs::Severity severity) const noexcept
+{
+  auto severity_value = static_cast<uint8_t>(severity);
+  if (severity_value == 0 || severity_value > 24)
+  {
+    return false;
+  }
+  return event_sets_->GetDefault()[(severity_value - 1) >> 2]->Enabled();
+}
+
+bool Exporter::IsEnabled(opentelemetry::logs::Severity severity,
+                         nostd::string_view event_name) const noexcept
+{
+  auto severity_value = static_cast<uint8_t>(severity);
+  if (severity_value == 0 || severity_value > 24)
+  {
+    return false;
+  }
+  return event_sets_->Find(event_name)[(severity_value - 1) >> 2]->Enabled();
+}
+
 bool Exporter::isShutdown() const noexcept
 {
   const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(lock_);
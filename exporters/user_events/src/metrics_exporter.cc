@@ -6,6 +6,8 @@
 
 #include "tracepoint/tracepoint.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <mutex>
 
@@ -15,6 +17,103 @@ namespace exporter {
 namespace user_events {
 namespace metrics {
 
+namespace
+{
+
+using ExportMetricsServiceRequest = proto::collector::metrics::v1::ExportMetricsServiceRequest;
+
+// Initial arena block, grown to fit the largest request seen so far.
+constexpr size_t kInitialArenaBlockSize = 64 * 1024;
+
+// Upper bound for the retained arena block.
+constexpr size_t kMaxArenaBlockSize = 16 * 1024 * 1024;
+
+// Upper bound for the tag and length prefix of a nested message.
+constexpr size_t kFieldOverhead = 1 + 5;
+
+// Split the data points of `data` into copies of `metric` of at most `limit` bytes each. A data
+// point that does not fit on its own is dropped. Returns the number of dropped data points.
+template <class Data, class MutableData, class AddMetric>
+size_t SplitDataPoints(const proto::metrics::v1::Metric &metric,
+                       const Data &data,
+                       MutableData mutable_data,
+                       size_t limit,
+                       google::protobuf::Arena &arena,
+                       AddMetric &add_metric)
+{
+  auto *part = google::protobuf::Arena::Create<proto::metrics::v1::Metric>(&arena);
+  part->CopyFrom(metric);
+  mutable_data(part)->clear_data_points();
+
+  const size_t part_header_size = part->ByteSizeLong() + kFieldOverhead;
+  size_t part_size              = part_header_size;
+  size_t dropped                = 0;
+
+  for (const auto &point : data.data_points())
+  {
+    size_t point_size = point.ByteSizeLong() + kFieldOverhead;
+    if (part_header_size + point_size > limit)
+    {
+      ++dropped;
+      continue;
+    }
+
+    if (part_size + point_size > limit)
+    {
+      add_metric(*part, part_size);
+      mutable_data(part)->clear_data_points();
+      part_size = part_header_size;
+    }
+
+    *mutable_data(part)->add_data_points() = point;
+    part_size += point_size;
+  }
+
+  if (mutable_data(part)->data_points_size() > 0)
+  {
+    add_metric(*part, part_size);
+  }
+
+  return dropped;
+}
+
+template <class AddMetric>
+size_t SplitMetric(const proto::metrics::v1::Metric &metric,
+                   size_t limit,
+                   google::protobuf::Arena &arena,
+                   AddMetric &add_metric)
+{
+  using proto::metrics::v1::Metric;
+
+  switch (metric.data_case())
+  {
+    case Metric::kGauge:
+      return SplitDataPoints(
+          metric, metric.gauge(), [](Metric *m) { return m->mutable_gauge(); }, limit, arena,
+          add_metric);
+    case Metric::kSum:
+      return SplitDataPoints(
+          metric, metric.sum(), [](Metric *m) { return m->mutable_sum(); }, limit, arena,
+          add_metric);
+    case Metric::kHistogram:
+      return SplitDataPoints(
+          metric, metric.histogram(), [](Metric *m) { return m->mutable_histogram(); }, limit,
+          arena, add_metric);
+    case Metric::kExponentialHistogram:
+      return SplitDataPoints(
+          metric, metric.exponential_histogram(),
+          [](Metric *m) { return m->mutable_exponential_histogram(); }, limit, arena, add_metric);
+    case Metric::kSummary:
+      return SplitDataPoints(
+          metric, metric.summary(), [](Metric *m) { return m->mutable_summary(); }, limit, arena,
+          add_metric);
+    default:
+      return 1;
+  }
+}
+
+}  // namespace
+
 // -------------------------------- Constructors --------------------------------
 
 Exporter::Exporter() : Exporter(ExporterOptions()) {}
@@ -23,6 +122,8 @@ Exporter::Exporter(const ExporterOptions &options)
 : options_(options),
     aggregation_temporality_selector_{otlp_exporter::OtlpMetricUtils::ChooseTemporalitySelector(options_.aggregation_temporality)}
 {
+  arena_block_.resize(kInitialArenaBlockSize);
+
   int err;
 
   err = tracepoint_open_provider(&provider_);
@@ -66,29 +167,172 @@ sdk_common::ExportResult Exporter::Export(
     return sdk_common::ExportResult::kSuccess;
   }
 
-  proto::collector::metrics::v1::ExportMetricsServiceRequest request;
-  otlp_exporter::OtlpMetricUtils::PopulateRequest(data, &request);
+  const std::lock_guard<std::mutex> guard(export_lock_);
+
+  sdk_common::ExportResult result;
+  size_t arena_size = 0;
+  {
+    google::protobuf::ArenaOptions arena_options;
+    arena_options.initial_block      = arena_block_.data();
+    arena_options.initial_block_size = arena_block_.size();
+    google::protobuf::Arena arena(arena_options);
+
+    auto *request = google::protobuf::Arena::Create<ExportMetricsServiceRequest>(&arena);
+    otlp_exporter::OtlpMetricUtils::PopulateRequest(data, request);
 
+    if (request->ByteSizeLong() + sizeof(int) <= options_.max_event_size)
+    {
+      result = WriteRequest(*request);
+    }
+    else
+    {
+      result = WriteChunked(*request, arena);
+    }
+
+    arena_size = static_cast<size_t>(arena.SpaceAllocated());
+  }
+
+  // Let the next export fit into a single arena block.
+  if (arena_size > arena_block_.size())
+  {
+    arena_block_.resize((std::min)(arena_size, kMaxArenaBlockSize));
+  }
+
+  return result;
+}
+
+bool Exporter::IsEnabled() const noexcept
+{
+  return TRACEPOINT_ENABLED(&otlp_metrics_);
+}
+
+sdk_common::ExportResult Exporter::WriteRequest(const ExportMetricsServiceRequest &request) noexcept
+{
   int size = (int)request.ByteSizeLong();
-  char *buffer = new char[size+sizeof(int)];
-  request.SerializeToArray(buffer+sizeof(int), size);
-  memcpy(buffer, &size, sizeof(int));
+  if (buffer_.size() < size + sizeof(int))
+  {
+    buffer_.resize(size + sizeof(int));
+  }
+  memcpy(buffer_.data(), &size, sizeof(int));
+  request.SerializeWithCachedSizesToArray(
+      reinterpret_cast<uint8_t *>(buffer_.data() + sizeof(int)));
 
   struct iovec data_vecs[] = {
     {},
-    { buffer, size+sizeof(int)},
+    { buffer_.data(), size+sizeof(int)},
   };
 
   int err = tracepoint_write(&otlp_metrics_, sizeof(data_vecs)/sizeof(data_vecs[0]), data_vecs);
   if (err)
   {
       OTEL_INTERNAL_LOG_ERROR("[user_events Metrics Exporter] Exporting failed with " << err);
-                              
+
       return sdk_common::ExportResult::kFailure;
   }
   return sdk_common::ExportResult::kSuccess;
 }
 
+sdk_common::ExportResult Exporter::WriteChunked(const ExportMetricsServiceRequest &request,
+                                                google::protobuf::Arena &arena) noexcept
+{
+  auto result = sdk_common::ExportResult::kSuccess;
+
+  size_t dropped = SplitRequest(request, options_.max_event_size, arena,
+                                [&](const ExportMetricsServiceRequest &chunk) {
+                                  if (WriteRequest(chunk) != sdk_common::ExportResult::kSuccess)
+                                  {
+                                    result = sdk_common::ExportResult::kFailure;
+                                  }
+                                });
+  if (dropped > 0)
+  {
+    dropped_count_ += dropped;
+    OTEL_INTERNAL_LOG_ERROR("[user_events Metrics Exporter] Dropped "
+                            << dropped << " data points larger than max_event_size");
+
+    result = sdk_common::ExportResult::kFailure;
+  }
+
+  return result;
+}
+
+size_t Exporter::SplitRequest(
+    const ExportMetricsServiceRequest &request,
+    size_t limit,
+    google::protobuf::Arena &arena,
+    nostd::function_ref<void(const ExportMetricsServiceRequest &)> write) noexcept
+{
+  size_t dropped = 0;
+
+  auto *chunk = google::protobuf::Arena::Create<ExportMetricsServiceRequest>(&arena);
+  size_t chunk_size = sizeof(int);
+  bool chunk_empty = true;
+
+  auto flush = [&]() {
+    if (!chunk_empty)
+    {
+      write(*chunk);
+    }
+    chunk->Clear();
+    chunk_size  = sizeof(int);
+    chunk_empty = true;
+  };
+
+  for (const auto &resource_metrics : request.resource_metrics())
+  {
+    for (const auto &scope_metrics : resource_metrics.scope_metrics())
+    {
+      // Every chunk repeats the resource and scope of the metrics it holds.
+      const size_t header_size =
+          resource_metrics.resource().ByteSizeLong() + resource_metrics.schema_url().size() +
+          scope_metrics.scope().ByteSizeLong() + scope_metrics.schema_url().size() +
+          6 * kFieldOverhead;
+      const size_t metric_limit =
+          limit > sizeof(int) + header_size ? limit - sizeof(int) - header_size : 0;
+
+      proto::metrics::v1::ScopeMetrics *scope_chunk = nullptr;
+      auto add_metric = [&](const proto::metrics::v1::Metric &metric, size_t metric_size) {
+        if (!chunk_empty && chunk_size + metric_size > limit)
+        {
+          flush();
+          scope_chunk = nullptr;
+        }
+
+        if (scope_chunk == nullptr)
+        {
+          auto *resource_chunk               = chunk->add_resource_metrics();
+          *resource_chunk->mutable_resource() = resource_metrics.resource();
+          resource_chunk->set_schema_url(resource_metrics.schema_url());
+          scope_chunk                     = resource_chunk->add_scope_metrics();
+          *scope_chunk->mutable_scope() = scope_metrics.scope();
+          scope_chunk->set_schema_url(scope_metrics.schema_url());
+          chunk_size += header_size;
+        }
+
+        *scope_chunk->add_metrics() = metric;
+        chunk_size += metric_size;
+        chunk_empty = false;
+      };
+
+      for (const auto &metric : scope_metrics.metrics())
+      {
+        size_t metric_size = metric.ByteSizeLong() + kFieldOverhead;
+        if (metric_size <= metric_limit)
+        {
+          add_metric(metric, metric_size);
+        }
+        else
+        {
+          dropped += SplitMetric(metric, metric_limit, arena, add_metric);
+        }
+      }
+    }
+  }
+  flush();
+
+  return dropped;
+}
+
 bool Exporter::ForceFlush(std::chrono::microseconds timeout) noexcept
 {
   return true;
@@ -19,6 +19,29 @@ namespace api_logs = opentelemetry::logs;
 
 Recordable::Recordable() noexcept {}
 
+Recordable::Recordable(std::shared_ptr<const EventSetRegistry> event_sets) noexcept
+    : event_sets_(std::move(event_sets)),
+      levels_(event_sets_ != nullptr ? &event_sets_->GetDefault() : nullptr)
+{}
+
+void Recordable::Reset() noexcept
+{
+  event_builder_.Reset("Logs");
+  trace_id_                = opentelemetry::trace::TraceId();
+  span_id_                 = opentelemetry::trace::SpanId();
+  event_id_                = 0;
+  event_name_              = nostd::string_view();
+  level_index_             = 0;
+  cs_part_b_bookmark_      = 0;
+  cs_part_b_bookmark_size_ = 0;
+  cs_part_c_bookmark_      = 0;
+  cs_part_c_bookmark_size_ = 0;
+  severity_                = 0;
+  has_event_id_            = false;
+  enabled_                 = true;
+  levels_                  = event_sets_ != nullptr ? &event_sets_->GetDefault() : nullptr;
+}
+
 void Recordable::SetSeverity(api_logs::Severity severity) noexcept
 {
   uint8_t severity_value = static_cast<uint8_t>(severity);
@@ -30,11 +53,31 @@ void Recordable::SetSeverity(api_logs::Severity severity) noexcept
   }
 
   severity_    = severity_value;
-  level_index_ = (severity_value - 1) >> 2;
+  level_index_ = severity_value > 0 ? (severity_value - 1) >> 2 : 0;
+
+  // Skip all encoding work when nobody listens to this level. Until the event name is known
+  // the record may still be routed to the event sets of its name.
+  if (levels_ == nullptr)
+  {
+    enabled_ = true;
+  }
+  else if (has_event_id_)
+  {
+    enabled_ = (*levels_)[level_index_]->Enabled();
+  }
+  else
+  {
+    enabled_ = event_sets_->AnyEnabled(level_index_);
+  }
 }
 
 void Recordable::SetBody(const opentelemetry::common::AttributeValue &message) noexcept
 {
+  if (!enabled_)
+  {
+    return;
+  }
+
   if (severity_ == 0)
   {
     OTEL_INTERNAL_LOG_ERROR("[user_events Log Exporter] Recordable: severity is not set.");
@@ -46,6 +89,16 @@ void Recordable::SetBody(const opentelemetry::common::AttributeValue &message) n
   event_builder_.Reset(event_name);
   event_builder_.AddValue("__csver__", static_cast<uint16_t>(0x400), event_field_format_unsigned_int);
 
+  if (trace_id_.IsValid())
+  {
+    event_builder_.AddStruct("PartA", span_id_.IsValid() ? 2 : 1);
+    utils::PopulateBinary("ext_dt_traceId", trace_id_.Id(), event_builder_);
+    if (span_id_.IsValid())
+    {
+      utils::PopulateBinary("ext_dt_spanId", span_id_.Id(), event_builder_);
+    }
+  }
+
   event_builder_.AddStruct("PartB", 1, 0, &cs_part_b_bookmark_);
   event_builder_.AddString<char>("_typeName", "Log", event_field_format_default);
   event_builder_.AddValue("severityNumber", static_cast<uint16_t>(severity_),
@@ -68,16 +121,26 @@ void Recordable::SetEventId(int64_t id, nostd::string_view name) noexcept
   has_event_id_ = true;
   event_id_     = id;
   event_name_   = name;
+
+  if (event_sets_ != nullptr)
+  {
+    // Events configured with their own keyword are enabled independently of the others. Body
+    // and attributes already set were encoded if any keyword listens at this level.
+    levels_  = &event_sets_->Find(name);
+    enabled_ = enabled_ && (*levels_)[level_index_]->Enabled();
+  }
 }
 
 void Recordable::SetTraceId(const opentelemetry::trace::TraceId &trace_id) noexcept
 {
   // optional for logs.
+  trace_id_ = trace_id;
 }
 
 void Recordable::SetSpanId(const opentelemetry::trace::SpanId &span_id) noexcept
 {
   // optional for logs.
+  span_id_ = span_id;
 }
 
 //
@@ -87,6 +150,11 @@ void Recordable::SetSpanId(const opentelemetry::trace::SpanId &span_id) noexcept
 void Recordable::SetAttribute(nostd::string_view key,
                               const opentelemetry::common::AttributeValue &value) noexcept
 {
+  if (!enabled_)
+  {
+    return;
+  }
+
   if (cs_part_c_bookmark_size_ == 0)
   {
     event_builder_.AddStruct("PartC", 1, 0, &cs_part_c_bookmark_);
@@ -103,6 +171,11 @@ void Recordable::SetTimestamp(opentelemetry::common::SystemTimestamp timestamp)
 
 bool Recordable::PrepareExport() noexcept
 {
+  if (!enabled_)
+  {
+    return false;
+  }
+
   if (cs_part_b_bookmark_size_ == 0)
   {
     // Part B is mandatory for exporting to user_events.
@@ -0,0 +1,87 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include "opentelemetry/exporters/user_events/trace/exporter.h"
+#include "opentelemetry/exporters/user_events/trace/recordable.h"
+#include "opentelemetry/sdk/common/global_log_handler.h"
+
+namespace nostd     = opentelemetry::nostd;
+namespace sdktrace  = opentelemetry::sdk::trace;
+namespace sdkcommon = opentelemetry::sdk::common;
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace trace
+{
+
+/*********************** Constructor ***********************/
+
+Exporter::Exporter(const ExporterOptions &options) noexcept
+    : options_(options), provider_(options.provider_name)
+{
+  event_set_ = provider_.RegisterSet(event_level_information, 1);
+}
+
+/*********************** Exporter methods ***********************/
+
+std::unique_ptr<sdk_trace::Recordable> Exporter::MakeRecordable() noexcept
+{
+  return std::unique_ptr<Recordable>(new Recordable(event_set_));
+}
+
+sdk::common::ExportResult Exporter::Export(
+    const nostd::span<std::unique_ptr<sdktrace::Recordable>> &spans) noexcept
+{
+  if (isShutdown())
+  {
+    OTEL_INTERNAL_LOG_ERROR("[user_events Trace Exporter] Exporting "
+                            << spans.size() << " span(s) failed, exporter is shutdown");
+    return sdk::common::ExportResult::kFailure;
+  }
+
+  if (!event_set_->Enabled())
+  {
+    // event_set is not enabled
+    return sdk::common::ExportResult::kSuccess;
+  }
+
+  for (auto &span : spans)
+  {
+    auto user_events_span = std::unique_ptr<Recordable>(static_cast<Recordable *>(span.release()));
+
+    if (user_events_span == nullptr || !user_events_span->PrepareExport())
+    {
+      continue;
+    }
+
+    int err = user_events_span->GetEventBuilder().Write(*event_set_);
+    if (err != 0)
+    {
+      OTEL_INTERNAL_LOG_ERROR("[user_events Trace Exporter] Exporting failed, error code: " << err);
+      return sdk::common::ExportResult::kFailure;
+    }
+  }
+
+  return sdk::common::ExportResult::kSuccess;
+}
+
+bool Exporter::Shutdown(std::chrono::microseconds) noexcept
+{
+  const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(lock_);
+  is_shutdown_ = true;
+  return true;
+}
+
+bool Exporter::isShutdown() const noexcept
+{
+  const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(lock_);
+  return is_shutdown_;
+}
+
+}  // namespace trace
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
@@ -0,0 +1,97 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include "opentelemetry/exporters/user_events/trace/recordable.h"
+#include "opentelemetry/exporters/user_events/logs/utils.h"
+#include "opentelemetry/sdk/common/global_log_handler.h"
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace trace
+{
+
+namespace api_trace = opentelemetry::trace;
+
+Recordable::Recordable(std::shared_ptr<const ehd::EventSet> event_set) noexcept
+    : enabled_(event_set == nullptr || event_set->Enabled())
+{}
+
+void Recordable::SetIdentity(const api_trace::SpanContext &span_context,
+                             api_trace::SpanId parent_span_id) noexcept
+{
+  trace_id_       = span_context.trace_id();
+  span_id_        = span_context.span_id();
+  parent_span_id_ = parent_span_id;
+}
+
+void Recordable::SetAttribute(nostd::string_view key,
+                              const opentelemetry::common::AttributeValue &value) noexcept
+{
+  if (!enabled_)
+  {
+    return;
+  }
+
+  attributes_.SetAttribute(key, value);
+}
+
+void Recordable::SetStatus(api_trace::StatusCode code, nostd::string_view description) noexcept
+{
+  status_code_        = code;
+  status_description_ = std::string(description.data(), description.size());
+}
+
+void Recordable::SetName(nostd::string_view name) noexcept
+{
+  if (!enabled_)
+  {
+    return;
+  }
+
+  name_ = std::string(name.data(), name.size());
+}
+
+void Recordable::SetSpanKind(api_trace::SpanKind span_kind) noexcept
+{
+  span_kind_ = span_kind;
+}
+
+void Recordable::SetStartTime(opentelemetry::common::SystemTimestamp start_time) noexcept
+{
+  start_time_ = start_time;
+}
+
+void Recordable::SetDuration(std::chrono::nanoseconds duration) noexcept
+{
+  duration_ = duration;
+}
+
+bool Recordable::PrepareExport() noexcept
+{
+  if (!enabled_)
+  {
+    return false;
+  }
+
+  if (!span_id_.IsValid())
+  {
+    OTEL_INTERNAL_LOG_ERROR("[user_events Trace Exporter] Recordable: span identity is not set.");
+    return false;
+  }
+
+  event_builder_.Reset("Span");
+  event_builder_.AddValue("__csver__", static_cast<uint16_t>(0x400), event_field_format_unsigned_int);
+
+  utils::EventBuilderSink sink(event_builder_);
+  EncodeFields(sink);
+
+  return true;
+}
+
+}  // namespace trace
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
@@ -13,6 +13,49 @@
 namespace sdk_logs         = opentelemetry::sdk::logs;
 namespace user_events_logs = opentelemetry::exporter::user_events::logs;
 
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace logs
+{
+class ExporterTestPeer
+{
+public:
+  static opentelemetry::sdk::common::ExportResult Enqueue(
+      Exporter &exporter,
+      std::vector<std::unique_ptr<Recordable>> &pending)
+  {
+    return exporter.Enqueue(pending);
+  }
+
+  // The writer thread recycles every record it wrote into the recordable pool.
+  static size_t PooledRecordables(Exporter &exporter)
+  {
+    const std::lock_guard<opentelemetry::common::SpinLockMutex> locked(exporter.pool_lock_);
+    return exporter.recordable_pool_.size();
+  }
+};
+}  // namespace logs
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
+
+// Records are only queued for an enabled tracepoint, the tests queue prepared records directly.
+static std::vector<std::unique_ptr<user_events_logs::Recordable>> MakeRecords(
+    user_events_logs::Exporter &exporter,
+    size_t count)
+{
+  std::vector<std::unique_ptr<user_events_logs::Recordable>> records;
+  for (size_t i = 0; i < count; ++i)
+  {
+    records.emplace_back(
+        static_cast<user_events_logs::Recordable *>(exporter.MakeRecordable().release()));
+  }
+  return records;
+}
+
 // Test that when OStream Log exporter is shutdown, no logs should be sent to stream
 TEST(UserEventsLogRecordExporter, Shutdown)
 {
@@ -31,3 +74,117 @@ TEST(UserEventsLogRecordExporter, Shutdown)
 
   std::cout.rdbuf(original);
 }
+
+// Test that the writer thread is drained and stopped by ForceFlush and Shutdown
+TEST(UserEventsLogRecordExporter, WriterThreadShutdown)
+{
+  auto options              = user_events_logs::ExporterOptions();
+  options.use_writer_thread = true;
+  auto exporter =
+      std::unique_ptr<sdk_logs::LogRecordExporter>(new user_events_logs::Exporter(options));
+
+  EXPECT_TRUE(exporter->ForceFlush(std::chrono::milliseconds(100)));
+  EXPECT_TRUE(exporter->Shutdown());
+  EXPECT_TRUE(exporter->ForceFlush(std::chrono::milliseconds(100)));
+}
+
+// Test that records queued before Shutdown are written by the writer thread
+TEST(UserEventsLogRecordExporter, WriterThreadWritesQueuedRecordsOnShutdown)
+{
+  auto options                 = user_events_logs::ExporterOptions();
+  options.use_writer_thread    = true;
+  options.max_queue_size       = 8;
+  options.recordable_pool_size = 8;
+  user_events_logs::Exporter exporter(options);
+
+  auto records = MakeRecords(exporter, 3);
+  EXPECT_EQ(user_events_logs::ExporterTestPeer::Enqueue(exporter, records),
+            opentelemetry::sdk::common::ExportResult::kSuccess);
+
+  EXPECT_TRUE(exporter.Shutdown());
+  EXPECT_EQ(user_events_logs::ExporterTestPeer::PooledRecordables(exporter), 3u);
+  EXPECT_EQ(exporter.GetDroppedCount(), 0u);
+}
+
+// Test that records beyond max_queue_size are dropped and counted
+TEST(UserEventsLogRecordExporter, WriterThreadQueueFull)
+{
+  auto options                 = user_events_logs::ExporterOptions();
+  options.use_writer_thread    = true;
+  options.max_queue_size       = 2;
+  options.recordable_pool_size = 8;
+  user_events_logs::Exporter exporter(options);
+
+  // The queue lock is held while the records are queued, so the writer thread cannot make room.
+  auto records = MakeRecords(exporter, 5);
+  EXPECT_EQ(user_events_logs::ExporterTestPeer::Enqueue(exporter, records),
+            opentelemetry::sdk::common::ExportResult::kFailureFull);
+  EXPECT_EQ(exporter.GetDroppedCount(), 3u);
+
+  // Only the queued records reach the writer.
+  EXPECT_TRUE(exporter.Shutdown());
+  EXPECT_EQ(user_events_logs::ExporterTestPeer::PooledRecordables(exporter), 2u);
+  EXPECT_EQ(exporter.GetDroppedCount(), 3u);
+}
+
+// Test that records of an event name with its own keyword are routed to their own event sets
+TEST(UserEventsLogRecordExporter, EventKeywords)
+{
+  auto options           = user_events_logs::ExporterOptions();
+  options.event_keywords = {{"Company.Component.Audit", 0x10}, {"Company.Component.Trace", 0x10}};
+  user_events_logs::Exporter exporter(options);
+
+  // No listener is attached in the test environment.
+  EXPECT_FALSE(exporter.IsEnabled(opentelemetry::logs::Severity::kInfo,
+                                  "Company.Component.Audit"));
+  EXPECT_FALSE(exporter.IsEnabled(opentelemetry::logs::Severity::kInfo, "Unconfigured"));
+
+  auto record = exporter.MakeRecordable();
+  record->SetSeverity(opentelemetry::logs::Severity::kWarn);
+  record->SetEventId(1, "Company.Component.Audit");
+  record->SetBody("audit");
+
+  auto user_events_record = static_cast<user_events_logs::Recordable *>(record.get());
+  EXPECT_EQ(user_events_record->IsEnabled(),
+            exporter.IsEnabled(opentelemetry::logs::Severity::kWarn, "Company.Component.Audit"));
+  EXPECT_EQ(user_events_record->PrepareExport(), user_events_record->IsEnabled());
+
+  std::unique_ptr<sdk_logs::Recordable> records[] = {std::move(record)};
+  EXPECT_EQ(exporter.Export(records), opentelemetry::sdk::common::ExportResult::kSuccess);
+}
+
+// Test that setting the event id after the body keeps the body of an event whose keyword is
+// enabled while the default keyword is not
+TEST(UserEventsLogRecordExporter, EventIdAfterBody)
+{
+  auto options           = user_events_logs::ExporterOptions();
+  options.event_keywords = {{"Company.Component.Audit", 0x10}};
+  user_events_logs::Exporter exporter(options);
+
+  const bool event_enabled =
+      exporter.IsEnabled(opentelemetry::logs::Severity::kWarn, "Company.Component.Audit");
+
+  auto body_first = exporter.MakeRecordable();
+  body_first->SetSeverity(opentelemetry::logs::Severity::kWarn);
+  body_first->SetBody("audit");
+  body_first->SetAttribute("user", "alice");
+  body_first->SetEventId(1, "Company.Component.Audit");
+
+  auto event_first = exporter.MakeRecordable();
+  event_first->SetSeverity(opentelemetry::logs::Severity::kWarn);
+  event_first->SetEventId(1, "Company.Component.Audit");
+  event_first->SetBody("audit");
+  event_first->SetAttribute("user", "alice");
+
+  auto body_first_record  = static_cast<user_events_logs::Recordable *>(body_first.get());
+  auto event_first_record = static_cast<user_events_logs::Recordable *>(event_first.get());
+  EXPECT_EQ(&body_first_record->GetEventSet(), &event_first_record->GetEventSet());
+
+  // Both orders end up with the enablement of the event keyword, whatever the default keyword,
+  // and an enabled record still has the Part B written by SetBody.
+  for (auto *record : {body_first_record, event_first_record})
+  {
+    EXPECT_EQ(record->IsEnabled(), event_enabled);
+    EXPECT_EQ(record->PrepareExport(), event_enabled);
+  }
+}
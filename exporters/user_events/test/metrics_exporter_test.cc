@@ -0,0 +1,148 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include "opentelemetry/exporters/user_events/metrics/exporter.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace user_events_metrics = opentelemetry::exporter::user_events::metrics;
+namespace proto_metrics       = opentelemetry::proto::metrics::v1;
+
+using ExportMetricsServiceRequest =
+    opentelemetry::proto::collector::metrics::v1::ExportMetricsServiceRequest;
+
+OPENTELEMETRY_BEGIN_NAMESPACE
+namespace exporter
+{
+namespace user_events
+{
+namespace metrics
+{
+class ExporterTestPeer
+{
+public:
+  static size_t SplitRequest(const ExportMetricsServiceRequest &request,
+                             size_t limit,
+                             std::vector<ExportMetricsServiceRequest> &chunks)
+  {
+    google::protobuf::Arena arena;
+    return Exporter::SplitRequest(request, limit, arena,
+                                  [&](const ExportMetricsServiceRequest &chunk) {
+                                    chunks.push_back(chunk);
+                                  });
+  }
+};
+}  // namespace metrics
+}  // namespace user_events
+}  // namespace exporter
+OPENTELEMETRY_END_NAMESPACE
+
+static proto_metrics::ScopeMetrics *AddScope(ExportMetricsServiceRequest &request)
+{
+  auto *resource_metrics = request.add_resource_metrics();
+  auto *attribute        = resource_metrics->mutable_resource()->add_attributes();
+  attribute->set_key("service.name");
+  attribute->mutable_value()->set_string_value("user_events_test");
+
+  auto *scope_metrics = resource_metrics->add_scope_metrics();
+  scope_metrics->mutable_scope()->set_name("test_scope");
+  return scope_metrics;
+}
+
+static void AddGauge(proto_metrics::ScopeMetrics *scope_metrics,
+                     const std::string &name,
+                     size_t point_count,
+                     size_t attribute_size = 8)
+{
+  auto *metric = scope_metrics->add_metrics();
+  metric->set_name(name);
+  for (size_t i = 0; i < point_count; ++i)
+  {
+    auto *point = metric->mutable_gauge()->add_data_points();
+    point->set_as_int(static_cast<int64_t>(i));
+    auto *attribute = point->add_attributes();
+    attribute->set_key("key");
+    attribute->mutable_value()->set_string_value(std::string(attribute_size, 'x'));
+  }
+}
+
+static size_t CountDataPoints(const ExportMetricsServiceRequest &request, const std::string &name)
+{
+  size_t count = 0;
+  for (const auto &resource_metrics : request.resource_metrics())
+  {
+    for (const auto &scope_metrics : resource_metrics.scope_metrics())
+    {
+      for (const auto &metric : scope_metrics.metrics())
+      {
+        if (metric.name() == name)
+        {
+          count += metric.gauge().data_points_size();
+        }
+      }
+    }
+  }
+  return count;
+}
+
+// Test that metrics are packed into chunks below the limit, each repeating resource and scope
+TEST(UserEventsMetricsExporter, SplitRequestByMetric)
+{
+  ExportMetricsServiceRequest request;
+  auto *scope_metrics = AddScope(request);
+  for (int i = 0; i < 20; ++i)
+  {
+    AddGauge(scope_metrics, "small_" + std::to_string(i), 4);
+  }
+
+  const size_t limit = 512;
+  std::vector<ExportMetricsServiceRequest> chunks;
+  EXPECT_EQ(user_events_metrics::ExporterTestPeer::SplitRequest(request, limit, chunks), 0u);
+
+  ASSERT_GT(chunks.size(), 1u);
+  int metric_count = 0;
+  for (const auto &chunk : chunks)
+  {
+    EXPECT_LE(chunk.ByteSizeLong() + sizeof(int), limit);
+    ASSERT_EQ(chunk.resource_metrics_size(), 1);
+    EXPECT_EQ(chunk.resource_metrics(0).resource().attributes(0).key(), "service.name");
+    ASSERT_EQ(chunk.resource_metrics(0).scope_metrics_size(), 1);
+    EXPECT_EQ(chunk.resource_metrics(0).scope_metrics(0).scope().name(), "test_scope");
+    metric_count += chunk.resource_metrics(0).scope_metrics(0).metrics_size();
+  }
+  EXPECT_EQ(metric_count, 20);
+}
+
+// Test that a single metric above the limit is split by data point, and that a data point
+// above the limit is dropped and counted
+TEST(UserEventsMetricsExporter, SplitRequestOversizedMetric)
+{
+  ExportMetricsServiceRequest request;
+  auto *scope_metrics = AddScope(request);
+  AddGauge(scope_metrics, "small", 2);
+  AddGauge(scope_metrics, "large", 100);
+  AddGauge(scope_metrics, "oversized", 1, 1024);
+
+  const size_t limit = 512;
+  ASSERT_GT(request.ByteSizeLong(), limit);
+
+  std::vector<ExportMetricsServiceRequest> chunks;
+  EXPECT_EQ(user_events_metrics::ExporterTestPeer::SplitRequest(request, limit, chunks), 1u);
+
+  size_t small_points = 0;
+  size_t large_points = 0;
+  size_t oversized    = 0;
+  for (const auto &chunk : chunks)
+  {
+    EXPECT_LE(chunk.ByteSizeLong() + sizeof(int), limit);
+    small_points += CountDataPoints(chunk, "small");
+    large_points += CountDataPoints(chunk, "large");
+    oversized += CountDataPoints(chunk, "oversized");
+  }
+  EXPECT_EQ(small_points, 2u);
+  EXPECT_EQ(large_points, 100u);
+  EXPECT_EQ(oversized, 0u);
+}
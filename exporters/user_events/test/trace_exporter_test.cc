@@ -0,0 +1,144 @@
+// Copyright The OpenTelemetry Authors
+// SPDX-License-Identifier: Apache-2.0
+
+#include "opentelemetry/exporters/user_events/trace/exporter.h"
+#include "opentelemetry/exporters/user_events/trace/recordable.h"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdk_trace         = opentelemetry::sdk::trace;
+namespace user_events_trace = opentelemetry::exporter::user_events::trace;
+namespace api_trace         = opentelemetry::trace;
+namespace nostd             = opentelemetry::nostd;
+
+// Sink recording the encoded fields as (name, value) text pairs
+struct FieldSink
+{
+  std::vector<std::pair<std::string, std::string>> fields;
+
+  void BeginStruct(nostd::string_view name, uint8_t field_count)
+  {
+    fields.emplace_back(std::string(name.data(), name.size()), std::to_string(field_count));
+  }
+
+  void AddBinary(nostd::string_view key, nostd::span<const uint8_t> value)
+  {
+    static const char kHex[] = "0123456789abcdef";
+    std::string hex;
+    for (uint8_t byte : value)
+    {
+      hex += kHex[byte >> 4];
+      hex += kHex[byte & 0xf];
+    }
+    fields.emplace_back(std::string(key.data(), key.size()), hex);
+  }
+
+  void AddString(nostd::string_view key, nostd::string_view value)
+  {
+    fields.emplace_back(std::string(key.data(), key.size()),
+                        std::string(value.data(), value.size()));
+  }
+
+  template <class T>
+  void AddScalar(nostd::string_view key, T value)
+  {
+    fields.emplace_back(std::string(key.data(), key.size()), std::to_string(value));
+  }
+
+  template <class It>
+  void AddArray(nostd::string_view key, It first, It last)
+  {
+    fields.emplace_back(std::string(key.data(), key.size()),
+                        std::to_string(std::distance(first, last)));
+  }
+
+  template <class T>
+  void AddStringArray(nostd::string_view key, const T *first, const T *last)
+  {
+    fields.emplace_back(std::string(key.data(), key.size()), std::to_string(last - first));
+  }
+};
+
+// Test that when the trace exporter is shutdown, no spans are exported
+TEST(UserEventsSpanExporter, Shutdown)
+{
+  auto options  = user_events_trace::ExporterOptions();
+  auto exporter = std::unique_ptr<sdk_trace::SpanExporter>(new user_events_trace::Exporter(options));
+
+  EXPECT_TRUE(exporter->Shutdown());
+
+  auto recordable = exporter->MakeRecordable();
+  opentelemetry::nostd::span<std::unique_ptr<sdk_trace::Recordable>> batch(&recordable, 1);
+  EXPECT_EQ(exporter->Export(batch), opentelemetry::sdk::common::ExportResult::kFailure);
+}
+
+// Test that a span without identity is not prepared for export
+TEST(UserEventsSpanExporter, RecordableWithoutIdentity)
+{
+  user_events_trace::Recordable recordable(nullptr);
+  recordable.SetName("span");
+
+  EXPECT_TRUE(recordable.IsEnabled());
+  EXPECT_FALSE(recordable.PrepareExport());
+}
+
+// Test that an exported span is encoded with its ids in Part A, its fields in Part B and its
+// attributes in Part C
+TEST(UserEventsSpanExporter, EncodedFields)
+{
+  const uint8_t trace_id[16] = {0x4b, 0xf9, 0x2f, 0x35, 0x77, 0xb3, 0x4d, 0xa6,
+                                0xa3, 0xce, 0x92, 0x9d, 0x0e, 0x0e, 0x47, 0x36};
+  const uint8_t span_id[8]   = {0x00, 0xf0, 0x67, 0xaa, 0x0b, 0xa9, 0x02, 0xb7};
+  const uint8_t parent_id[8] = {0x53, 0x99, 0x5c, 0x3f, 0x42, 0xcd, 0x8a, 0xd8};
+
+  user_events_trace::Recordable recordable(nullptr);
+  recordable.SetIdentity(api_trace::SpanContext(api_trace::TraceId(trace_id),
+                                                api_trace::SpanId(span_id),
+                                                api_trace::TraceFlags(1), false),
+                         api_trace::SpanId(parent_id));
+  recordable.SetName("GET /users");
+  recordable.SetSpanKind(api_trace::SpanKind::kServer);
+  recordable.SetStatus(api_trace::StatusCode::kError, "timeout");
+  recordable.SetStartTime(opentelemetry::common::SystemTimestamp(std::chrono::nanoseconds(1000)));
+  recordable.SetDuration(std::chrono::nanoseconds(250));
+  recordable.SetAttribute("http.status_code", 504);
+
+  ASSERT_TRUE(recordable.PrepareExport());
+
+  FieldSink sink;
+  recordable.EncodeFields(sink);
+
+  std::vector<std::pair<std::string, std::string>> expected = {
+      {"PartA", "2"},
+      {"ext_dt_traceId", "4bf92f3577b34da6a3ce929d0e0e4736"},
+      {"ext_dt_spanId", "00f067aa0ba902b7"},
+      {"PartB", "8"},
+      {"_typeName", "Span"},
+      {"name", "GET /users"},
+      {"kind", std::to_string(static_cast<int>(api_trace::SpanKind::kServer))},
+      {"startTime", "1000"},
+      {"endTime", "1250"},
+      {"success", "0"},
+      {"parentId", "53995c3f42cd8ad8"},
+      {"statusMessage", "timeout"},
+      {"PartC", "1"},
+      {"http.status_code", "504"},
+  };
+  EXPECT_EQ(sink.fields, expected);
+
+  // Without a listener the event is not written, the export still succeeds.
+  auto options  = user_events_trace::ExporterOptions();
+  auto exporter = std::unique_ptr<sdk_trace::SpanExporter>(new user_events_trace::Exporter(options));
+  auto span     = exporter->MakeRecordable();
+  span->SetIdentity(api_trace::SpanContext(api_trace::TraceId(trace_id), api_trace::SpanId(span_id),
+                                           api_trace::TraceFlags(1), false),
+                    api_trace::SpanId());
+  span->SetName("GET /users");
+  nostd::span<std::unique_ptr<sdk_trace::Recordable>> batch(&span, 1);
+  EXPECT_EQ(exporter->Export(batch), opentelemetry::sdk::common::ExportResult::kSuccess);
+}
@@ -12,11 +12,23 @@ enum OtelProcessorType
   OtelProcessorBatch
 };
 
+enum OtelExporterProtocol
+{
+  OtelExporterHttpProtobuf,
+  OtelExporterHttpJson,
+  OtelExporterGrpc
+};
+
 struct OtelNgxAgentConfig
 {
   struct
   {
     std::string endpoint;
+    OtelExporterProtocol protocol = OtelExporterHttpProtobuf;
+    bool gzip                     = false;
+    /* Exports sent over an HTTP connection before it is closed, 0 for the SDK default. */
+    uint32_t keepaliveRequests    = 0;
+    uint32_t timeoutMillis        = 10000;
   } exporter;
 
   struct
@@ -24,6 +36,12 @@ struct OtelNgxAgentConfig
     std::string name;
   } service;
 
+  struct
+  {
+    std::string endpoint;
+    uint32_t intervalMillis = 60000;
+  } metrics;
+
   struct
   {
     OtelProcessorType type = OtelProcessorBatch;
@@ -38,4 +56,19 @@ struct OtelNgxAgentConfig
 
   std::string sampler = "parentbased_always_on";
   double samplerRatio = 1.0;
+
+  /* Keep rules of the deferred sampler. */
+  struct
+  {
+    bool enabled = false;
+    /* Keeps this share of the other requests, samplerRatio once set. */
+    double ratio = 0.01;
+    /* Keeps requests at least this slow, 0 for none. */
+    uint32_t latencyMillis = 0;
+    /* Keeps responses with at least this status. */
+    ngx_uint_t minStatus = 500;
+  } deferredSampling;
+
+  /* Time budget of the span flush when a worker process exits. */
+  uint32_t exitFlushTimeoutMillis = 5000;
 };
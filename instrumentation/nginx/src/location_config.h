@@ -1,16 +1,29 @@
 #pragma once
 
 #include "trace_context.h"
+#include "request_metrics.h"
 #include "script.h"
 
 extern "C" {
 extern ngx_module_t otel_ngx_module;
 }
 
+/* Header listed by opentelemetry_capture_headers_allowlist. */
+struct OtelCapturedHeader {
+  /* Lowercase header name. */
+  ngx_str_t name;
+  /* Normalized attribute keys. */
+  ngx_str_t requestKey;
+  ngx_str_t responseKey;
+  /* Whether the name matches opentelemetry_sensitive_header_names. */
+  bool sensitive;
+};
+
 struct OtelNgxLocationConf {
   ngx_flag_t enabled = NGX_CONF_UNSET;
   ngx_flag_t trustIncomingSpans = NGX_CONF_UNSET;
   ngx_flag_t captureHeaders = NGX_CONF_UNSET;
+  ngx_flag_t metrics = NGX_CONF_UNSET;
 #if (NGX_PCRE)
   ngx_regex_t *sensitiveHeaderNames = (ngx_regex_t*)NGX_CONF_UNSET_PTR;
   ngx_regex_t *sensitiveHeaderValues = (ngx_regex_t*)NGX_CONF_UNSET_PTR;
@@ -19,6 +32,12 @@ struct OtelNgxLocationConf {
   TracePropagationType propagationType = TracePropagationUnset;
   NgxCompiledScript operationNameScript;
   ngx_array_t* customAttributes = nullptr;
+  /* Configured header names (ngx_str_t), null to capture all headers. */
+  ngx_array_t* capturedHeaderNames = nullptr;
+  /* OtelCapturedHeader sorted by name length then name, built on merge. */
+  ngx_array_t* capturedHeaders = nullptr;
+  /* RED metrics aggregator, bound on merge when metrics are on. */
+  OtelNgxLocationMetrics* locationMetrics = nullptr;
 };
 
 inline OtelNgxLocationConf* GetOtelLocationConf(ngx_http_request_t* req) {
@@ -2,8 +2,11 @@
 #include <opentelemetry/sdk/trace/samplers/always_off.h>
 #include <opentelemetry/trace/span.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <new>
 #include <unordered_map>
 #include <vector>
 
@@ -21,11 +24,14 @@ extern ngx_module_t otel_ngx_module;
 #include "nginx_config.h"
 #include "nginx_utils.h"
 #include "propagate.h"
+#include "request_metrics.h"
+#include "span_pipeline.h"
 #include <opentelemetry/context/context.h>
 #include <opentelemetry/nostd/shared_ptr.h>
 #include <opentelemetry/sdk/trace/batch_span_processor.h>
 #include <opentelemetry/sdk/trace/batch_span_processor_options.h>
 #include <opentelemetry/sdk/trace/id_generator.h>
+#include <opentelemetry/sdk/trace/random_id_generator.h>
 #include <opentelemetry/sdk/trace/samplers/always_on_factory.h>
 #include <opentelemetry/sdk/trace/samplers/always_off_factory.h>
 #include <opentelemetry/sdk/trace/samplers/trace_id_ratio_factory.h>
@@ -34,8 +40,12 @@ extern ngx_module_t otel_ngx_module;
 #include <opentelemetry/sdk/trace/samplers/parent_factory.h>
 
 #include <opentelemetry/sdk/trace/tracer_provider.h>
+#include <opentelemetry/trace/default_span.h>
 #include <opentelemetry/trace/provider.h>
 #include <opentelemetry/exporters/otlp/otlp_http_exporter.h>
+#ifdef OTEL_NGX_WITH_OTLP_GRPC
+#include <opentelemetry/exporters/otlp/otlp_grpc_exporter.h>
+#endif
 
 namespace trace = opentelemetry::trace;
 namespace nostd = opentelemetry::nostd;
@@ -54,8 +64,52 @@ const ScriptAttributeDeclaration kDefaultScriptAttributes[] = {
 struct OtelMainConf {
   ngx_array_t* scriptAttributes;
   OtelNgxAgentConfig agentConfig;
+  /* Shared memory of the shared span pipeline, null without it. */
+  ngx_shm_zone_t* spanRingZone = nullptr;
+  /* OtelNgxLocationMetrics* of the locations with metrics on. */
+  ngx_array_t* locationMetrics = nullptr;
+};
+
+/*
+ * Id generator of the tracer provider. The deferred sampler creates the spans
+ * it keeps when their request ends, with the ids propagated when it started.
+ */
+class OtelNgxIdGenerator final : public sdktrace::IdGenerator {
+public:
+  OtelNgxIdGenerator() : sdktrace::IdGenerator(true) {}
+
+  trace::SpanId GenerateSpanId() noexcept override {
+    return presetSpanId_.IsValid() ? presetSpanId_ : random_.GenerateSpanId();
+  }
+
+  trace::TraceId GenerateTraceId() noexcept override {
+    return presetTraceId_.IsValid() ? presetTraceId_ : random_.GenerateTraceId();
+  }
+
+  /* Ids of the next span started, an invalid context for random ids again. */
+  void Preset(const trace::SpanContext& context) {
+    presetTraceId_ = context.trace_id();
+    presetSpanId_ = context.span_id();
+  }
+
+private:
+  sdktrace::RandomIdGenerator random_;
+  trace::TraceId presetTraceId_;
+  trace::SpanId presetSpanId_;
+};
+
+/* Span pipeline of the worker process, flushed when it exits. */
+struct OtelNgxWorkerPipeline {
+  /* Owned by the tracer provider. */
+  sdktrace::SpanProcessor* processor = nullptr;
+  OtelNgxIdGenerator* idGenerator = nullptr;
+  std::atomic<uint64_t> endedSpans{0};
+  /* Spans exported, or written to the shared span pipeline. */
+  std::atomic<uint64_t> exportedSpans{0};
 };
 
+static OtelNgxWorkerPipeline workerPipeline;
+
 nostd::shared_ptr<trace::Tracer> GetTracer() {
   return trace::Provider::GetTracerProvider()->GetTracer("nginx");
 }
@@ -86,11 +140,102 @@ static void NgxNormalizeAndCopyString(u_char* dst, ngx_str_t str) {
   }
 }
 
-static void OtelCaptureHeaders(nostd::shared_ptr<opentelemetry::trace::Span> span, ngx_str_t keyPrefix, ngx_list_t *headers,
+static ngx_str_t NgxCreateHeaderKey(ngx_pool_t* pool, ngx_str_t keyPrefix, ngx_str_t name) {
+  u_char* key = (u_char*)ngx_pnalloc(pool, keyPrefix.len + name.len);
+
+  if (!key) {
+    return ngx_null_string;
+  }
+
+  NgxNormalizeAndCopyString(ngx_copy(key, keyPrefix.data, keyPrefix.len), name);
+
+  return {keyPrefix.len + name.len, key};
+}
+
+static void OtelSetHeaderAttribute(
+  trace::Span* span, ngx_str_t key, ngx_str_t value, bool sensitiveHeader) {
+  nostd::string_view attributeValue;
+  if (sensitiveHeader) {
+    attributeValue = "[REDACTED]";
+  } else {
+    attributeValue = FromNgxString(value);
+  }
+
+  span->SetAttribute(FromNgxString(key), nostd::span<const nostd::string_view>(&attributeValue, 1));
+}
+
+static bool IsSensitiveHeaderValue(OtelNgxLocationConf* locConf, ngx_str_t* value) {
 #if (NGX_PCRE)
-                        ngx_regex_t *sensitiveHeaderNames, ngx_regex_t *sensitiveHeaderValues,
+  if (locConf->sensitiveHeaderValues) {
+    int ovector[3];
+    return ngx_regex_exec(locConf->sensitiveHeaderValues, value, ovector, 0) >= 0;
+  }
 #endif
-                        nostd::span<ngx_table_elt_t*> excludedHeaders) {
+  (void)locConf;
+  (void)value;
+  return false;
+}
+
+static ngx_int_t CompareCapturedHeaderName(ngx_str_t name, ngx_str_t lowercaseName) {
+  if (name.len != lowercaseName.len) {
+    return name.len < lowercaseName.len ? -1 : 1;
+  }
+
+  return ngx_strncasecmp(name.data, lowercaseName.data, name.len);
+}
+
+static const OtelCapturedHeader* FindCapturedHeader(const ngx_array_t* capturedHeaders, ngx_str_t name) {
+  const OtelCapturedHeader* headers = (const OtelCapturedHeader*)capturedHeaders->elts;
+  ngx_uint_t low = 0;
+  ngx_uint_t high = capturedHeaders->nelts;
+
+  while (low < high) {
+    ngx_uint_t middle = low + (high - low) / 2;
+    ngx_int_t rc = CompareCapturedHeaderName(name, headers[middle].name);
+
+    if (rc == 0) {
+      return &headers[middle];
+    }
+
+    if (rc < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+
+  return nullptr;
+}
+
+/*
+ * Captures the headers of the allowlist. The attribute keys and the sensitive
+ * name check are prepared at configuration time, so nothing is allocated here.
+ */
+static void OtelCaptureAllowedHeaders(trace::Span* span, bool response, ngx_list_t* headers,
+                                      OtelNgxLocationConf* locConf,
+                                      nostd::span<ngx_table_elt_t*> excludedHeaders) {
+  for (ngx_list_part_t* part = &headers->part; part != nullptr; part = part->next) {
+    ngx_table_elt_t* header = (ngx_table_elt_t*)part->elts;
+    for (ngx_uint_t i = 0; i < part->nelts; ++i) {
+      const OtelCapturedHeader* captured = FindCapturedHeader(locConf->capturedHeaders, header[i].key);
+      if (!captured) {
+        continue;
+      }
+
+      if (std::find(excludedHeaders.begin(), excludedHeaders.end(), &header[i]) != excludedHeaders.end()) {
+        continue;
+      }
+
+      bool sensitiveHeader = captured->sensitive || IsSensitiveHeaderValue(locConf, &header[i].value);
+      OtelSetHeaderAttribute(
+        span, response ? captured->responseKey : captured->requestKey, header[i].value, sensitiveHeader);
+    }
+  }
+}
+
+static void OtelCaptureHeaders(trace::Span* span, ngx_pool_t* pool, ngx_str_t keyPrefix, ngx_list_t* headers,
+                               OtelNgxLocationConf* locConf,
+                               nostd::span<ngx_table_elt_t*> excludedHeaders) {
   for (ngx_list_part_t *part = &headers->part; part != nullptr; part = part->next) {
     ngx_table_elt_t *header = (ngx_table_elt_t*) part->elts;
     for (ngx_uint_t i = 0; i < part->nelts; ++i) {
@@ -98,42 +243,29 @@ static void OtelCaptureHeaders(nostd::shared_ptr<opentelemetry::trace::Span> spa
         continue;
       }
 
-      std::vector<u_char> key(keyPrefix.len + header[i].key.len, 0);
-      NgxNormalizeAndCopyString((u_char*)ngx_copy(key.data(), keyPrefix.data, keyPrefix.len), header[i].key);
+      ngx_str_t key = NgxCreateHeaderKey(pool, keyPrefix, header[i].key);
+      if (key.len == 0) {
+        continue;
+      }
 
       bool sensitiveHeader = false;
 #if (NGX_PCRE)
-      if (sensitiveHeaderNames) {
-        int ovector[3];
-        if (ngx_regex_exec(sensitiveHeaderNames, &header[i].key, ovector, 0) >= 0) {
-          sensitiveHeader = true;
-        }
-      }
-      if (sensitiveHeaderValues && !sensitiveHeader) {
+      if (locConf->sensitiveHeaderNames) {
         int ovector[3];
-        if (ngx_regex_exec(sensitiveHeaderValues, &header[i].value, ovector, 0) >= 0) {
+        if (ngx_regex_exec(locConf->sensitiveHeaderNames, &header[i].key, ovector, 0) >= 0) {
           sensitiveHeader = true;
         }
       }
 #endif
-
-      nostd::string_view value;
-      if (sensitiveHeader) {
-        value = "[REDACTED]";
-      } else {
-        value = FromNgxString(header[i].value);
+      if (!sensitiveHeader) {
+        sensitiveHeader = IsSensitiveHeaderValue(locConf, &header[i].value);
       }
 
-      span->SetAttribute({(const char*)key.data(), keyPrefix.len + header[i].key.len}, nostd::span<const nostd::string_view>(&value, 1));
+      OtelSetHeaderAttribute(span, key, header[i].value, sensitiveHeader);
     }
   }
 }
 
-static ngx_int_t OtelGetContextVar(ngx_http_request_t*, ngx_http_variable_value_t*, uintptr_t) {
-  // Filled out on context creation.
-  return NGX_OK;
-}
-
 static ngx_int_t
 OtelGetTraceContextVar(ngx_http_request_t* req, ngx_http_variable_value_t* v, uintptr_t data);
 
@@ -147,14 +279,6 @@ static ngx_int_t
 OtelGetSampled(ngx_http_request_t* req, ngx_http_variable_value_t* v, uintptr_t data);
 
 static ngx_http_variable_t otel_ngx_variables[] = {
-  {
-    ngx_string("otel_ctx"),
-    nullptr,
-    OtelGetContextVar,
-    0,
-    NGX_HTTP_VAR_NOCACHEABLE | NGX_HTTP_VAR_NOHASH,
-    0,
-  },
   {
     ngx_string(kOtelCtxVarPrefix),
     nullptr,
@@ -190,8 +314,82 @@ static ngx_http_variable_t otel_ngx_variables[] = {
   ngx_http_null_variable,
 };
 
-static bool IsOtelEnabled(ngx_http_request_t* req) {
-  OtelNgxLocationConf* locConf = GetOtelLocationConf(req);
+/*
+ * Per-request state of the module, attached with ngx_http_set_ctx. Subrequests
+ * get their own. It lives in a cleanup of the request pool, which destroys it
+ * with the request.
+ */
+struct OtelNgxRequestContext {
+  OtelNgxRequestContext(ngx_http_request_t* req) : traceContext(req) {}
+  /* Location conf the enabled decision was taken for, null if not taken yet. */
+  OtelNgxLocationConf* enabledLocConf = nullptr;
+  bool enabled = false;
+  /* Whether traceContext holds the span of the request. */
+  bool hasTraceContext = false;
+  /*
+   * With the deferred sampler, traceContext holds a non recording span until
+   * the request ends, these are what the kept span is created from.
+   */
+  bool deferred = false;
+  trace::SpanContext deferredParent = trace::SpanContext::GetInvalid();
+  opentelemetry::common::SystemTimestamp deferredStartTime;
+  opentelemetry::common::SteadyTimestamp deferredSteadyStartTime;
+  TraceContext traceContext;
+};
+
+static void RequestContextCleanup(void* data) {
+  OtelNgxRequestContext* ctx = (OtelNgxRequestContext*)data;
+  ctx->~OtelNgxRequestContext();
+}
+
+/*
+ * Internal redirects clear the module contexts, the request context is then
+ * found again in the pool cleanups, as the realip module does.
+ */
+static OtelNgxRequestContext* GetRequestContext(ngx_http_request_t* req) {
+  OtelNgxRequestContext* ctx =
+    (OtelNgxRequestContext*)ngx_http_get_module_ctx(req, otel_ngx_module);
+
+  if (ctx || !req->internal) {
+    return ctx;
+  }
+
+  for (ngx_pool_cleanup_t* cleanup = req->pool->cleanup; cleanup; cleanup = cleanup->next) {
+    if (cleanup->handler != RequestContextCleanup) {
+      continue;
+    }
+
+    ctx = (OtelNgxRequestContext*)cleanup->data;
+    if (ctx->traceContext.request == req) {
+      ngx_http_set_ctx(req, ctx, otel_ngx_module);
+      return ctx;
+    }
+  }
+
+  return nullptr;
+}
+
+static OtelNgxRequestContext* GetOrCreateRequestContext(ngx_http_request_t* req) {
+  OtelNgxRequestContext* ctx = GetRequestContext(req);
+
+  if (ctx) {
+    return ctx;
+  }
+
+  ngx_pool_cleanup_t* cleanup = ngx_pool_cleanup_add(req->pool, sizeof(OtelNgxRequestContext));
+
+  if (!cleanup) {
+    return nullptr;
+  }
+
+  ctx = new (cleanup->data) OtelNgxRequestContext(req);
+  cleanup->handler = RequestContextCleanup;
+  ngx_http_set_ctx(req, ctx, otel_ngx_module);
+
+  return ctx;
+}
+
+static bool EvaluateOtelEnabled(ngx_http_request_t* req, OtelNgxLocationConf* locConf) {
   if (locConf->enabled) {
 #if (NGX_PCRE)
     int ovector[3];
@@ -204,23 +402,39 @@ static bool IsOtelEnabled(ngx_http_request_t* req) {
   }
 }
 
-TraceContext* GetTraceContext(ngx_http_request_t* req) {
-  ngx_http_variable_value_t* val = ngx_http_get_indexed_variable(req, otel_ngx_variables[0].index);
+/*
+ * The decision is taken once per request and location: the span handlers and
+ * every $opentelemetry_* variable ask for it, and the ignore paths regex is
+ * not cheap to run.
+ */
+static bool IsOtelEnabled(ngx_http_request_t* req) {
+  OtelNgxLocationConf* locConf = GetOtelLocationConf(req);
 
-  if (val == nullptr || val->not_found) {
-    ngx_log_error(NGX_LOG_INFO, req->connection->log, 0, "TraceContext not found");
-    return nullptr;
+  if (!locConf->enabled) {
+    return false;
   }
 
-  std::unordered_map<ngx_http_request_t*, TraceContext*>* map = (std::unordered_map<ngx_http_request_t*, TraceContext*>*)val->data;
-  if (map == nullptr) {
-    ngx_log_error(NGX_LOG_INFO, req->connection->log, 0, "TraceContext not found");
-    return nullptr;
+  OtelNgxRequestContext* ctx = GetOrCreateRequestContext(req);
+
+  if (!ctx) {
+    return EvaluateOtelEnabled(req, locConf);
+  }
+
+  if (ctx->enabledLocConf != locConf) {
+    ctx->enabled = EvaluateOtelEnabled(req, locConf);
+    ctx->enabledLocConf = locConf;
   }
-  auto it = map->find(req);
-  if (it != map->end()) {
-    return it->second;
+
+  return ctx->enabled;
+}
+
+TraceContext* GetTraceContext(ngx_http_request_t* req) {
+  OtelNgxRequestContext* ctx = GetRequestContext(req);
+
+  if (ctx && ctx->hasTraceContext) {
+    return &ctx->traceContext;
   }
+
   ngx_log_error(NGX_LOG_INFO, req->connection->log, 0, "TraceContext not found");
   return nullptr;
 }
@@ -428,16 +642,6 @@ OtelGetSpanId(ngx_http_request_t* req, ngx_http_variable_value_t* v, uintptr_t d
   return NGX_OK;
 }
 
-void TraceContextCleanup(void* data) {
-  TraceContext* context = (TraceContext*)data;
-  context->~TraceContext();
-}
-
-void RequestContextMapCleanup(void* data) {
-  std::unordered_map<ngx_http_request_t*, TraceContext*>* map = (std::unordered_map<ngx_http_request_t*, TraceContext*>*)data;
-  map->~unordered_map();
-}
-
 nostd::string_view GetOperationName(ngx_http_request_t* req) {
   OtelNgxLocationConf* locationConf = GetOtelLocationConf(req);
 
@@ -474,26 +678,184 @@ nostd::string_view GetNgxServerName(const ngx_http_request_t* req) {
   return FromNgxString(cscf->server_name);
 }
 
-TraceContext* CreateTraceContext(ngx_http_request_t* req, ngx_http_variable_value_t* val) {
-  ngx_pool_cleanup_t* cleanup = ngx_pool_cleanup_add(req->pool, sizeof(TraceContext));
-  TraceContext* context = (TraceContext*)cleanup->data;
-  new (context) TraceContext(req);
-  cleanup->handler = TraceContextCleanup;
+TraceContext* CreateTraceContext(ngx_http_request_t* req) {
+  OtelNgxRequestContext* ctx = GetOrCreateRequestContext(req);
 
-  std::unordered_map<ngx_http_request_t*, TraceContext*>* map;
-  if (req->parent && val->data) {
-    // Subrequests will already have the map created so just retrieve it
-    map = (std::unordered_map<ngx_http_request_t*, TraceContext*>*)val->data;
-  } else {
-    ngx_pool_cleanup_t* cleanup = ngx_pool_cleanup_add(req->pool, sizeof(std::unordered_map<ngx_http_request_t*, TraceContext*>));
-    map = (std::unordered_map<ngx_http_request_t*, TraceContext*>*)cleanup->data;
-    new (map) std::unordered_map<ngx_http_request_t*, TraceContext*>();
-    cleanup->handler = RequestContextMapCleanup;
-    val->data = (unsigned char*)cleanup->data;
-    val->len = sizeof(std::unordered_map<ngx_http_request_t*, TraceContext*>);
+  if (!ctx) {
+    return nullptr;
+  }
+
+  ctx->hasTraceContext = true;
+  return &ctx->traceContext;
+}
+
+static nostd::shared_ptr<trace::Span>
+StartRequestSpan(ngx_http_request_t* req, const trace::StartSpanOptions& startOpts) {
+  return GetTracer()->StartSpan(
+    GetOperationName(req),
+    {
+      {"http.method", FromNgxString(req->method_name)},
+      {"http.flavor", NgxHttpFlavor(req)},
+      {"http.target", FromNgxString(req->unparsed_uri)},
+    },
+    startOpts);
+}
+
+static void
+AddRequestAttributes(trace::Span* span, ngx_http_request_t* req, OtelNgxLocationConf* locConf) {
+  nostd::string_view serverName = GetNgxServerName(req);
+  if (!serverName.empty()) {
+    span->SetAttribute("http.server_name", serverName);
+  }
+
+  if (req->headers_in.host) {
+    span->SetAttribute("http.host", FromNgxString(req->headers_in.host->value));
+  }
+
+  if (req->headers_in.user_agent) {
+    span->SetAttribute("http.user_agent", FromNgxString(req->headers_in.user_agent->value));
+  }
+
+  if (locConf->captureHeaders) {
+    ngx_table_elt_t* excludedHeaders[] = {req->headers_in.host, req->headers_in.user_agent};
+    if (locConf->capturedHeaders) {
+      OtelCaptureAllowedHeaders(span, false, &req->headers_in.headers, locConf, {excludedHeaders, 2});
+    } else {
+      OtelCaptureHeaders(span, req->pool, ngx_string("http.request.header."),
+                         &req->headers_in.headers, locConf, {excludedHeaders, 2});
+    }
+  }
+}
+
+/*
+ * Allocator of a request pool, the memory is released with the pool.
+ */
+template <class T>
+struct NgxPoolAllocator {
+  using value_type = T;
+
+  NgxPoolAllocator(ngx_pool_t* pool) : pool(pool) {}
+  template <class U>
+  NgxPoolAllocator(const NgxPoolAllocator<U>& other) : pool(other.pool) {}
+
+  T* allocate(size_t n) {
+    void* p = ngx_palloc(pool, n * sizeof(T));
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    return (T*)p;
+  }
+
+  void deallocate(T*, size_t) {}
+
+  ngx_pool_t* pool;
+};
+
+template <class T, class U>
+static bool operator==(const NgxPoolAllocator<T>& a, const NgxPoolAllocator<U>& b) {
+  return a.pool == b.pool;
+}
+
+template <class T, class U>
+static bool operator!=(const NgxPoolAllocator<T>& a, const NgxPoolAllocator<U>& b) {
+  return a.pool != b.pool;
+}
+
+static void DeferredSpanCleanup(void* data) {
+  trace::DefaultSpan* span = (trace::DefaultSpan*)data;
+  span->~DefaultSpan();
+}
+
+/*
+ * The span of a request under the deferred sampler: the ids are propagated
+ * with the flags of the parent, as sampled without a parent, nothing is
+ * recorded until the request ends. The span and its reference count live in
+ * the request pool, a cleanup destroys the span with the request. Returns
+ * null when the pool is out of memory.
+ */
+static nostd::shared_ptr<trace::Span>
+StartDeferredSpan(ngx_http_request_t* req, OtelNgxRequestContext* ctx, trace::SpanContext parent) {
+  OtelNgxIdGenerator* ids = workerPipeline.idGenerator;
+
+  ngx_pool_cleanup_t* cleanup = ngx_pool_cleanup_add(req->pool, sizeof(trace::DefaultSpan));
+
+  if (!cleanup) {
+    return nullptr;
+  }
+
+  trace::SpanContext spanContext(
+    parent.IsValid() ? parent.trace_id() : ids->GenerateTraceId(), ids->GenerateSpanId(),
+    parent.IsValid() ? parent.trace_flags() : trace::TraceFlags(trace::TraceFlags::kIsSampled),
+    false, parent.trace_state());
+
+  ctx->deferred = true;
+  ctx->deferredParent = parent;
+  ctx->deferredStartTime = opentelemetry::common::SystemTimestamp(std::chrono::system_clock::now());
+  ctx->deferredSteadyStartTime = opentelemetry::common::SteadyTimestamp(std::chrono::steady_clock::now());
+
+  trace::DefaultSpan* span = new (cleanup->data) trace::DefaultSpan(spanContext);
+  cleanup->handler = DeferredSpanCleanup;
+
+  // The cleanup owns the span, the pointer only shares it within the request.
+  return nostd::shared_ptr<trace::Span>(std::shared_ptr<trace::Span>(
+    span, [](trace::Span*) {}, NgxPoolAllocator<trace::Span>(req->pool)));
+}
+
+/*
+ * Same trace id, same decision, on every host using the same ratio: the first
+ * 8 bytes of the trace id are read as a big-endian number, whatever the byte
+ * order of the host.
+ */
+static bool IsTraceIdInRatio(trace::TraceId traceId, double ratio) {
+  if (ratio >= 1.0) {
+    return true;
+  }
+
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(value); i++) {
+    value = (value << 8) | traceId.Id()[i];
   }
-  map->insert({req, context});
-  return context;
+
+  return (double)value < ratio * (double)UINT64_MAX;
+}
+
+/*
+ * Takes the keep or drop decision of a deferred span, then creates the kept
+ * span in the SDK. Returns null for a dropped span.
+ */
+static nostd::shared_ptr<trace::Span>
+PromoteDeferredSpan(ngx_http_request_t* req, OtelNgxRequestContext* ctx) {
+  const OtelNgxAgentConfig* agentConf = &GetOtelMainConf(req)->agentConfig;
+  trace::SpanContext spanContext = ctx->traceContext.request_span->GetContext();
+
+  auto elapsed = std::chrono::steady_clock::now().time_since_epoch() -
+                 ctx->deferredSteadyStartTime.time_since_epoch();
+
+  // A sampled parent already propagated its decision downstream.
+  bool keep =
+    ctx->deferredParent.IsSampled() ||
+    req->headers_out.status >= agentConf->deferredSampling.minStatus ||
+    (agentConf->deferredSampling.latencyMillis > 0 &&
+     elapsed >= std::chrono::milliseconds(agentConf->deferredSampling.latencyMillis)) ||
+    IsTraceIdInRatio(spanContext.trace_id(), agentConf->deferredSampling.ratio);
+
+  if (!keep) {
+    return nullptr;
+  }
+
+  trace::StartSpanOptions startOpts;
+  startOpts.kind = trace::SpanKind::kServer;
+  startOpts.parent = ctx->deferredParent;
+  startOpts.start_system_time = ctx->deferredStartTime;
+  startOpts.start_steady_time = ctx->deferredSteadyStartTime;
+
+  workerPipeline.idGenerator->Preset(spanContext);
+  auto span = StartRequestSpan(req, startOpts);
+  workerPipeline.idGenerator->Preset(trace::SpanContext::GetInvalid());
+
+  AddRequestAttributes(span.get(), req, GetOtelLocationConf(req));
+
+  return span;
 }
 
 ngx_int_t StartNgxSpan(ngx_http_request_t* req) {
@@ -506,14 +868,19 @@ ngx_int_t StartNgxSpan(ngx_http_request_t* req) {
     return NGX_DECLINED;
   }
 
-  ngx_http_variable_value_t* val = ngx_http_get_indexed_variable(req, otel_ngx_variables[0].index);
-
-  if (!val) {
-    ngx_log_error(NGX_LOG_ERR, req->connection->log, 0, "Unable to find OpenTelemetry context");
+  // The rewrite phase runs again when a rewrite changes the location, the
+  // request keeps its first span.
+  OtelNgxRequestContext* ctx = GetRequestContext(req);
+  if (ctx && ctx->hasTraceContext) {
     return NGX_DECLINED;
   }
 
-  TraceContext* context = CreateTraceContext(req, val);
+  TraceContext* context = CreateTraceContext(req);
+
+  if (!context) {
+    ngx_log_error(NGX_LOG_ERR, req->connection->log, 0, "Unable to create OpenTelemetry context");
+    return NGX_DECLINED;
+  }
 
   OtelCarrier carrier{req, context};
   opentelemetry::context::Context incomingContext;
@@ -524,39 +891,24 @@ ngx_int_t StartNgxSpan(ngx_http_request_t* req) {
     incomingContext = ExtractContext(&carrier);
   }
 
-  trace::StartSpanOptions startOpts;
-  startOpts.kind = trace::SpanKind::kServer;
-  startOpts.parent = GetCurrentSpan(incomingContext);
-
-  context->request_span = GetTracer()->StartSpan(
-    GetOperationName(req),
-    {
-      {"http.method", FromNgxString(req->method_name)},
-      {"http.flavor", NgxHttpFlavor(req)},
-      {"http.target", FromNgxString(req->unparsed_uri)},
-    },
-    startOpts);
-
-  nostd::string_view serverName = GetNgxServerName(req);
-  if (!serverName.empty()) {
-    context->request_span->SetAttribute("http.server_name", serverName);
-  }
+  if (GetOtelMainConf(req)->agentConfig.deferredSampling.enabled) {
+    context->request_span = StartDeferredSpan(req, GetRequestContext(req), GetCurrentSpan(incomingContext));
 
-  if (req->headers_in.host) {
-    context->request_span->SetAttribute("http.host", FromNgxString(req->headers_in.host->value));
-  }
+    if (!context->request_span) {
+      ngx_log_error(NGX_LOG_ERR, req->connection->log, 0, "Unable to allocate the deferred span");
+      return NGX_DECLINED;
+    }
+  } else {
+    trace::StartSpanOptions startOpts;
+    startOpts.kind = trace::SpanKind::kServer;
+    startOpts.parent = GetCurrentSpan(incomingContext);
 
-  if (req->headers_in.user_agent) {
-    context->request_span->SetAttribute("http.user_agent", FromNgxString(req->headers_in.user_agent->value));
-  }
+    context->request_span = StartRequestSpan(req, startOpts);
 
-  if (locConf->captureHeaders) {
-    ngx_table_elt_t* excludedHeaders[] = {req->headers_in.host, req->headers_in.user_agent};
-    OtelCaptureHeaders(context->request_span, ngx_string("http.request.header."), &req->headers_in.headers,
-#if (NGX_PCRE)
-                       locConf->sensitiveHeaderNames, locConf->sensitiveHeaderValues,
-#endif
-                       {excludedHeaders, 2});
+    // A span dropped by the sampler is still propagated, but not enriched.
+    if (context->request_span->IsRecording()) {
+      AddRequestAttributes(context->request_span.get(), req, locConf);
+    }
   }
 
   auto outgoingContext = incomingContext.SetValue(trace::kSpanKey, context->request_span);
@@ -598,11 +950,26 @@ ngx_int_t FinishNgxSpan(ngx_http_request_t* req) {
 
   TraceContext* context = GetTraceContext(req);
 
-  if (!context) {
+  if (!context || !context->request_span) {
     return NGX_DECLINED;
   }
 
   auto span = context->request_span;
+
+  OtelNgxRequestContext* ctx = GetRequestContext(req);
+  if (ctx->deferred) {
+    span = PromoteDeferredSpan(req, ctx);
+
+    if (!span) {
+      return NGX_DECLINED;
+    }
+  }
+
+  if (!span->IsRecording()) {
+    span->End();
+    return NGX_DECLINED;
+  }
+
   const auto status_code = req->headers_out.status;
   span->SetAttribute("http.status_code", status_code);
 
@@ -615,11 +982,12 @@ ngx_int_t FinishNgxSpan(ngx_http_request_t* req) {
   OtelNgxLocationConf* locConf = GetOtelLocationConf(req);
 
   if (locConf->captureHeaders) {
-    OtelCaptureHeaders(span, ngx_string("http.response.header."), &req->headers_out.headers,
-#if (NGX_PCRE)
-                       locConf->sensitiveHeaderNames, locConf->sensitiveHeaderValues,
-#endif
-                       {});
+    if (locConf->capturedHeaders) {
+      OtelCaptureAllowedHeaders(span.get(), true, &req->headers_out.headers, locConf, {});
+    } else {
+      OtelCaptureHeaders(span.get(), req->pool, ngx_string("http.response.header."),
+                         &req->headers_out.headers, locConf, {});
+    }
   }
 
   AddScriptAttributes(span.get(), GetOtelMainConf(req)->scriptAttributes, req);
@@ -628,6 +996,24 @@ ngx_int_t FinishNgxSpan(ngx_http_request_t* req) {
   span->UpdateName(GetOperationName(req));
 
   span->End();
+  workerPipeline.endedSpans.fetch_add(1, std::memory_order_relaxed);
+  return NGX_DECLINED;
+}
+
+ngx_int_t RecordNgxRequestMetrics(ngx_http_request_t* req) {
+  OtelNgxLocationMetrics* metrics = GetOtelLocationConf(req)->locationMetrics;
+
+  if (!metrics) {
+    return NGX_DECLINED;
+  }
+
+  ngx_time_t* now = ngx_timeofday();
+  ngx_msec_int_t duration =
+    (ngx_msec_int_t)((now->sec - req->start_sec) * 1000 + (now->msec - req->start_msec));
+
+  OtelNgxRecordRequest(
+    metrics, (ngx_msec_t)ngx_max(duration, 0), req->headers_out.status >= 500);
+
   return NGX_DECLINED;
 }
 
@@ -643,6 +1029,7 @@ static ngx_int_t InitModule(ngx_conf_t* conf) {
   const PhaseHandler handlers[] = {
     {NGX_HTTP_REWRITE_PHASE, StartNgxSpan},
     {NGX_HTTP_LOG_PHASE, FinishNgxSpan},
+    {NGX_HTTP_LOG_PHASE, RecordNgxRequestMetrics},
   };
 
   for (const PhaseHandler& ph : handlers) {
@@ -662,6 +1049,11 @@ static ngx_int_t InitModule(ngx_conf_t* conf) {
     return NGX_ERROR;
   }
 
+  if (otelMainConf->spanRingZone && otelMainConf->agentConfig.exporter.protocol != OtelExporterHttpProtobuf) {
+    ngx_conf_log_error(NGX_LOG_EMERG, conf, 0, "opentelemetry: the shared span pipeline only exports http/protobuf");
+    return NGX_ERROR;
+  }
+
   otelMainConf->scriptAttributes = ngx_array_create(
     conf->pool, sizeof(kDefaultScriptAttributes) / sizeof(kDefaultScriptAttributes[0]),
     sizeof(CompiledScriptAttribute));
@@ -702,24 +1094,92 @@ static void* CreateOtelLocConf(ngx_conf_t* conf) {
   return locConf;
 }
 
-static char* MergeLocConf(ngx_conf_t*, void* parent, void* child) {
-  OtelNgxLocationConf* prev = (OtelNgxLocationConf*)parent;
-  OtelNgxLocationConf* conf = (OtelNgxLocationConf*)child;
+static int ngx_libc_cdecl CompareCapturedHeaders(const void* lhs, const void* rhs) {
+  const OtelCapturedHeader* left = (const OtelCapturedHeader*)lhs;
+  const OtelCapturedHeader* right = (const OtelCapturedHeader*)rhs;
 
-  ngx_conf_merge_value(conf->enabled, prev->enabled, 1);
+  return (int)CompareCapturedHeaderName(left->name, right->name);
+}
 
-  if (conf->propagationType == TracePropagationUnset) {
-    if (prev->propagationType != TracePropagationUnset) {
-      conf->propagationType = prev->propagationType;
-    } else {
-      conf->propagationType = TracePropagationW3C;
-    }
+static bool CompileCapturedHeaders(ngx_conf_t* conf, OtelNgxLocationConf* locConf) {
+  ngx_array_t* names = locConf->capturedHeaderNames;
+
+  locConf->capturedHeaders = ngx_array_create(conf->pool, names->nelts, sizeof(OtelCapturedHeader));
+
+  if (!locConf->capturedHeaders) {
+    return false;
   }
 
-  ngx_conf_merge_value(conf->trustIncomingSpans, prev->trustIncomingSpans, 1);
+  for (ngx_uint_t i = 0; i < names->nelts; i++) {
+    ngx_str_t name = ((ngx_str_t*)names->elts)[i];
+    OtelCapturedHeader* header = (OtelCapturedHeader*)ngx_array_push(locConf->capturedHeaders);
+
+    if (!header) {
+      return false;
+    }
+
+    header->name.data = (u_char*)ngx_pnalloc(conf->pool, name.len);
+    header->requestKey = NgxCreateHeaderKey(conf->pool, ngx_string("http.request.header."), name);
+    header->responseKey = NgxCreateHeaderKey(conf->pool, ngx_string("http.response.header."), name);
+
+    if (!header->name.data || header->requestKey.len == 0 || header->responseKey.len == 0) {
+      return false;
+    }
+
+    ngx_strlow(header->name.data, name.data, name.len);
+    header->name.len = name.len;
+
+    header->sensitive = false;
+#if (NGX_PCRE)
+    if (locConf->sensitiveHeaderNames) {
+      int ovector[3];
+      header->sensitive = ngx_regex_exec(locConf->sensitiveHeaderNames, &header->name, ovector, 0) >= 0;
+    }
+#endif
+  }
+
+  ngx_qsort(locConf->capturedHeaders->elts, locConf->capturedHeaders->nelts,
+            sizeof(OtelCapturedHeader), CompareCapturedHeaders);
+
+  return true;
+}
+
+static char* MergeLocConf(ngx_conf_t* cf, void* parent, void* child) {
+  OtelNgxLocationConf* prev = (OtelNgxLocationConf*)parent;
+  OtelNgxLocationConf* conf = (OtelNgxLocationConf*)child;
+
+  ngx_conf_merge_value(conf->enabled, prev->enabled, 1);
+
+  if (conf->propagationType == TracePropagationUnset) {
+    if (prev->propagationType != TracePropagationUnset) {
+      conf->propagationType = prev->propagationType;
+    } else {
+      conf->propagationType = TracePropagationW3C;
+    }
+  }
+
+  ngx_conf_merge_value(conf->trustIncomingSpans, prev->trustIncomingSpans, 1);
 
   ngx_conf_merge_value(conf->captureHeaders, prev->captureHeaders, 0);
 
+  ngx_conf_merge_value(conf->metrics, prev->metrics, 0);
+
+  ngx_http_core_loc_conf_t* coreLocConf =
+    (ngx_http_core_loc_conf_t*)ngx_http_conf_get_module_loc_conf(cf, ngx_http_core_module);
+
+  // The configuration of a server is merged too, with no location name.
+  if (conf->metrics && coreLocConf->name.len > 0) {
+    ngx_http_core_srv_conf_t* coreSrvConf =
+      (ngx_http_core_srv_conf_t*)ngx_http_conf_get_module_srv_conf(cf, ngx_http_core_module);
+
+    conf->locationMetrics = OtelNgxBindLocationMetrics(
+      cf, &GetOtelMainConf(cf)->locationMetrics, coreSrvConf->server_name, coreLocConf->name);
+
+    if (!conf->locationMetrics) {
+      return (char*)NGX_CONF_ERROR;
+    }
+  }
+
 #if (NGX_PCRE)
   ngx_conf_merge_ptr_value(conf->sensitiveHeaderNames, prev->sensitiveHeaderNames, nullptr);
   ngx_conf_merge_ptr_value(conf->sensitiveHeaderValues, prev->sensitiveHeaderValues, nullptr);
@@ -727,6 +1187,15 @@ static char* MergeLocConf(ngx_conf_t*, void* parent, void* child) {
   ngx_conf_merge_ptr_value(conf->ignore_paths, prev->ignore_paths, nullptr);
 #endif
 
+  if (!conf->capturedHeaderNames) {
+    conf->capturedHeaderNames = prev->capturedHeaderNames;
+  }
+
+  // Built for every location, the sensitive header names may differ.
+  if (conf->capturedHeaderNames && !CompileCapturedHeaders(cf, conf)) {
+    return (char*)NGX_CONF_ERROR;
+  }
+
   if (!prev->operationNameScript.IsEmpty() && conf->operationNameScript.IsEmpty()) {
     conf->operationNameScript = prev->operationNameScript;
   }
@@ -930,6 +1399,137 @@ char* OtelNgxSetEndpoint(ngx_conf_t* cf, ngx_command_t*, void*) {
   return NGX_CONF_OK;
 }
 
+char* OtelNgxSetExporterProtocol(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  std::string protocol((const char*)values[1].data, values[1].len);
+
+  if (protocol == "http/protobuf") {
+    otelMainConf->agentConfig.exporter.protocol = OtelExporterHttpProtobuf;
+  } else if (protocol == "http/json") {
+    otelMainConf->agentConfig.exporter.protocol = OtelExporterHttpJson;
+  } else if (protocol == "grpc") {
+#ifdef OTEL_NGX_WITH_OTLP_GRPC
+    otelMainConf->agentConfig.exporter.protocol = OtelExporterGrpc;
+#else
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: the module is built without OTLP/gRPC support");
+    return (char*)NGX_CONF_ERROR;
+#endif
+  } else {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: unknown OTLP protocol \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetExporterCompression(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  std::string compression((const char*)values[1].data, values[1].len);
+
+  if (compression == "gzip") {
+    otelMainConf->agentConfig.exporter.gzip = true;
+  } else if (compression == "none") {
+    otelMainConf->agentConfig.exporter.gzip = false;
+  } else {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: unknown OTLP compression \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetExporterKeepaliveRequests(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_int_t requests = ngx_atoi(values[1].data, values[1].len);
+
+  if (requests <= 0) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid OTLP keepalive requests \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  otelMainConf->agentConfig.exporter.keepaliveRequests = requests;
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetExporterTimeout(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_msec_t timeout = ngx_parse_time(&values[1], 0);
+
+  if (timeout == (ngx_msec_t)NGX_ERROR || timeout == 0) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid OTLP timeout \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  otelMainConf->agentConfig.exporter.timeoutMillis = timeout;
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetMetricsEndpoint(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_str_t* name = &values[1];
+
+  otelMainConf->agentConfig.metrics.endpoint = std::string((const char*)name->data, name->len);
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetMetricsInterval(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_msec_t interval = ngx_parse_time(&values[1], 0);
+
+  if (interval == (ngx_msec_t)NGX_ERROR || interval == 0) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid metrics interval \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  otelMainConf->agentConfig.metrics.intervalMillis = interval;
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetSharedSpanPipeline(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  if (otelMainConf->spanRingZone) {
+    return (char*)"is duplicate";
+  }
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ssize_t size = ngx_parse_size(&values[1]);
+
+  if (size == NGX_ERROR || size < (ssize_t)(8 * ngx_pagesize)) {
+    ngx_conf_log_error(
+      NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid shared span pipeline size \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  ngx_str_t name = ngx_string("opentelemetry_spans");
+  ngx_shm_zone_t* zone = ngx_shared_memory_add(cf, &name, size, &otel_ngx_module);
+
+  if (!zone) {
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  zone->init = OtelNgxInitSpanRing;
+  otelMainConf->spanRingZone = zone;
+
+  return NGX_CONF_OK;
+}
+
 char* OtelNgxSetSpanProcessorType(ngx_conf_t* cf, ngx_command_t*, void*) {
   OtelMainConf* otelMainConf = GetOtelMainConf(cf);
 
@@ -981,7 +1581,7 @@ char* OtelNgxSetBspScheduleDelayMillis(ngx_conf_t* cf, ngx_command_t*, void*) {
   if (v <= 0) {
     ngx_log_error(NGX_LOG_ERR, cf->log, 0, "opentelemetry: bsp schedule delay can't be <= 0");
   } else {
-    otelMainConf->agentConfig.processor.batch.maxExportBatchSize = v;
+    otelMainConf->agentConfig.processor.batch.scheduleDelayMillis = v;
   }
 
   return NGX_CONF_OK;
@@ -1005,6 +1605,28 @@ char* OtelNgxSetBspMaxExportBatchSize(ngx_conf_t* cf, ngx_command_t*, void*) {
   return NGX_CONF_OK;
 }
 
+char* OtelNgxSetExitFlushTimeout(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_msec_t timeout = ngx_parse_time(&values[1], 0);
+
+  if (timeout == (ngx_msec_t)NGX_ERROR) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid exit flush timeout \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  // The SDK waits without limit for a zero timeout.
+  if (timeout == 0) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: exit flush timeout can't be 0");
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  otelMainConf->agentConfig.exitFlushTimeoutMillis = timeout;
+
+  return NGX_CONF_OK;
+}
+
 char* OtelNgxSetTracesSampler(ngx_conf_t* cf, ngx_command_t*, void*) {
   OtelMainConf* otelMainConf = GetOtelMainConf(cf);
 
@@ -1019,7 +1641,8 @@ char* OtelNgxSetTracesSampler(ngx_conf_t* cf, ngx_command_t*, void*) {
     "traceidratio",
     "parentbased_always_on",
     "parentbased_always_off",
-    "parentbased_traceidratio"
+    "parentbased_traceidratio",
+    "deferred"
   };
 
   bool isValidSampler = false;
@@ -1032,6 +1655,7 @@ char* OtelNgxSetTracesSampler(ngx_conf_t* cf, ngx_command_t*, void*) {
 
   if (isValidSampler) {
     otelMainConf->agentConfig.sampler = strSampler;
+    otelMainConf->agentConfig.deferredSampling.enabled = strSampler == "deferred";
   } else {
     ngx_log_error(NGX_LOG_ERR, cf->log, 0, "opentelemetry: unknown sampler %V", values);
   }
@@ -1039,6 +1663,38 @@ char* OtelNgxSetTracesSampler(ngx_conf_t* cf, ngx_command_t*, void*) {
   return NGX_CONF_OK;
 }
 
+char* OtelNgxSetDeferredSamplingLatency(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_msec_t latency = ngx_parse_time(&values[1], 0);
+
+  if (latency == (ngx_msec_t)NGX_ERROR) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid deferred sampling latency \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  otelMainConf->agentConfig.deferredSampling.latencyMillis = latency;
+
+  return NGX_CONF_OK;
+}
+
+char* OtelNgxSetDeferredSamplingStatus(ngx_conf_t* cf, ngx_command_t*, void*) {
+  OtelMainConf* otelMainConf = GetOtelMainConf(cf);
+
+  ngx_str_t* values = (ngx_str_t*)cf->args->elts;
+  ngx_int_t status = ngx_atoi(values[1].data, values[1].len);
+
+  if (status < 100 || status > 599) {
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "opentelemetry: invalid deferred sampling status \"%V\"", &values[1]);
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  otelMainConf->agentConfig.deferredSampling.minStatus = status;
+
+  return NGX_CONF_OK;
+}
+
 char* OtelNgxSetTracesSamplerRatio(ngx_conf_t* cf, ngx_command_t*, void*) {
   OtelMainConf* otelMainConf = GetOtelMainConf(cf);
 
@@ -1048,6 +1704,7 @@ char* OtelNgxSetTracesSamplerRatio(ngx_conf_t* cf, ngx_command_t*, void*) {
   std::string strRatio((const char*)value->data, value->len);
 
   otelMainConf->agentConfig.samplerRatio = std::min(1.0, std::max(0.0, atof(strRatio.c_str())));
+  otelMainConf->agentConfig.deferredSampling.ratio = otelMainConf->agentConfig.samplerRatio;
   return NGX_CONF_OK;
 }
 
@@ -1079,6 +1736,33 @@ static char* OtelNgxSetCustomAttribute(ngx_conf_t* conf, ngx_command_t*, void* u
   return NGX_CONF_OK;
 }
 
+static char* OtelNgxSetCaptureHeadersAllowlist(ngx_conf_t* conf, ngx_command_t*, void* userConf) {
+  OtelNgxLocationConf* locConf = (OtelNgxLocationConf*)userConf;
+
+  if (locConf->capturedHeaderNames) {
+    return (char*)"is duplicate";
+  }
+
+  locConf->capturedHeaderNames = ngx_array_create(conf->pool, conf->args->nelts - 1, sizeof(ngx_str_t));
+
+  if (!locConf->capturedHeaderNames) {
+    return (char*)NGX_CONF_ERROR;
+  }
+
+  ngx_str_t* args = (ngx_str_t*)conf->args->elts;
+  for (ngx_uint_t i = 1; i < conf->args->nelts; i++) {
+    ngx_str_t* name = (ngx_str_t*)ngx_array_push(locConf->capturedHeaderNames);
+
+    if (!name) {
+      return (char*)NGX_CONF_ERROR;
+    }
+
+    *name = args[i];
+  }
+
+  return NGX_CONF_OK;
+}
+
 #if (NGX_PCRE)
 static ngx_regex_t* NgxCompileRegex(ngx_conf_t* conf, ngx_str_t pattern) {
   u_char err[NGX_MAX_CONF_ERRSTR];
@@ -1194,6 +1878,14 @@ static ngx_command_t kOtelNgxCommands[] = {
     offsetof(OtelNgxLocationConf, captureHeaders),
     nullptr,
   },
+  {
+    ngx_string("opentelemetry_capture_headers_allowlist"),
+    NGX_HTTP_MAIN_CONF | NGX_HTTP_SRV_CONF | NGX_HTTP_LOC_CONF | NGX_CONF_1MORE,
+    OtelNgxSetCaptureHeadersAllowlist,
+    NGX_HTTP_LOC_CONF_OFFSET,
+    0,
+    nullptr,
+  },
   {
     ngx_string("opentelemetry_otlp_traces_endpoint"),
     NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
@@ -1202,6 +1894,62 @@ static ngx_command_t kOtelNgxCommands[] = {
     0,
     nullptr,
   },
+  {
+    ngx_string("opentelemetry_otlp_traces_protocol"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetExporterProtocol,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_otlp_compression"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetExporterCompression,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_otlp_keepalive_requests"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetExporterKeepaliveRequests,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_otlp_timeout"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetExporterTimeout,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_metrics"),
+    NGX_HTTP_MAIN_CONF | NGX_HTTP_SRV_CONF | NGX_HTTP_LOC_CONF | NGX_CONF_FLAG,
+    ngx_conf_set_flag_slot,
+    NGX_HTTP_LOC_CONF_OFFSET,
+    offsetof(OtelNgxLocationConf, metrics),
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_otlp_metrics_endpoint"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetMetricsEndpoint,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_metrics_interval"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetMetricsInterval,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
   {
     ngx_string("opentelemetry_span_processor"),
     NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
@@ -1210,6 +1958,14 @@ static ngx_command_t kOtelNgxCommands[] = {
     0,
     nullptr,
   },
+  {
+    ngx_string("opentelemetry_shared_span_pipeline"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetSharedSpanPipeline,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
   {
     ngx_string("opentelemetry_bsp_max_queue_size"),
     NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
@@ -1234,6 +1990,14 @@ static ngx_command_t kOtelNgxCommands[] = {
     0,
     nullptr,
   },
+  {
+    ngx_string("opentelemetry_exit_flush_timeout"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetExitFlushTimeout,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
   {
     ngx_string("opentelemetry_traces_sampler"),
     NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
@@ -1250,6 +2014,22 @@ static ngx_command_t kOtelNgxCommands[] = {
     0,
     nullptr,
   },
+  {
+    ngx_string("opentelemetry_deferred_sampling_latency"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetDeferredSamplingLatency,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
+  {
+    ngx_string("opentelemetry_deferred_sampling_status"),
+    NGX_HTTP_MAIN_CONF | NGX_CONF_TAKE1,
+    OtelNgxSetDeferredSamplingStatus,
+    NGX_HTTP_MAIN_CONF_OFFSET,
+    0,
+    nullptr,
+  },
 #if (NGX_PCRE)
   {
     ngx_string("opentelemetry_sensitive_header_names"),
@@ -1279,12 +2059,70 @@ static ngx_command_t kOtelNgxCommands[] = {
   ngx_null_command,
 };
 
+/* Counts the spans the worker exported, to report the ones lost on exit. */
+class CountingSpanExporter final : public sdktrace::SpanExporter {
+public:
+  CountingSpanExporter(std::unique_ptr<sdktrace::SpanExporter> exporter, std::atomic<uint64_t>* exportedSpans)
+    : exporter_(std::move(exporter)), exportedSpans_(exportedSpans) {}
+
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return exporter_->MakeRecordable();
+  }
+
+  opentelemetry::sdk::common::ExportResult Export(
+    const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    auto result = exporter_->Export(spans);
+
+    if (result == opentelemetry::sdk::common::ExportResult::kSuccess) {
+      exportedSpans_->fetch_add(spans.size(), std::memory_order_relaxed);
+    }
+
+    return result;
+  }
+
+  bool ForceFlush(std::chrono::microseconds timeout) noexcept override {
+    return exporter_->ForceFlush(timeout);
+  }
+
+  bool Shutdown(std::chrono::microseconds timeout) noexcept override {
+    return exporter_->Shutdown(timeout);
+  }
+
+private:
+  std::unique_ptr<sdktrace::SpanExporter> exporter_;
+  std::atomic<uint64_t>* exportedSpans_;
+};
+
 static std::unique_ptr<sdktrace::SpanExporter> CreateExporter(const OtelNgxAgentConfig* conf) {
   std::unique_ptr<sdktrace::SpanExporter> exporter;
 
   std::string endpoint = conf->exporter.endpoint;
+  std::string compression = conf->exporter.gzip ? "gzip" : "none";
+  auto timeout = std::chrono::milliseconds(conf->exporter.timeoutMillis);
+
+#ifdef OTEL_NGX_WITH_OTLP_GRPC
+  if (conf->exporter.protocol == OtelExporterGrpc) {
+    otlp::OtlpGrpcExporterOptions opts;
+    opts.endpoint = endpoint.empty() ? opts.endpoint : endpoint;
+    opts.compression = compression;
+    opts.timeout = timeout;
+    exporter.reset(new otlp::OtlpGrpcExporter(opts));
+
+    return exporter;
+  }
+#endif
+
   otlp::OtlpHttpExporterOptions opts;
   opts.url = endpoint.empty() ? opts.url : endpoint;
+  opts.content_type = conf->exporter.protocol == OtelExporterHttpJson
+                        ? otlp::HttpRequestContentType::kJson
+                        : otlp::HttpRequestContentType::kBinary;
+  opts.compression = compression;
+  opts.timeout = timeout;
+  // The exporter client reuses its connections for this many requests.
+  if (conf->exporter.keepaliveRequests) {
+    opts.max_requests_per_connection = conf->exporter.keepaliveRequests;
+  }
   exporter.reset(new otlp::OtlpHttpExporter(opts));
 
   return exporter;
@@ -1328,6 +2166,11 @@ static std::unique_ptr<sdktrace::Sampler> CreateSampler(const OtelNgxAgentConfig
     return sdktrace::ParentBasedSamplerFactory::Create(std::make_shared<sdktrace::AlwaysOffSampler>());
   }
 
+  // Deferred spans are only created for the requests kept.
+  if (conf->sampler == "deferred") {
+    return sdktrace::AlwaysOnSamplerFactory::Create();
+  }
+
   if (conf->sampler == "parentbased_traceidratio") {
     return sdktrace::ParentBasedSamplerFactory::Create(std::make_shared<sdktrace::TraceIdRatioBasedSampler>(conf->samplerRatio));
   }
@@ -1351,13 +2194,50 @@ static ngx_int_t OtelNgxStart(ngx_cycle_t* cycle) {
 
   OtelNgxAgentConfig* agentConf = &otelMainConf->agentConfig;
 
-  auto exporter = CreateExporter(agentConf);
+  std::string serviceName = agentConf->service.name;
 
-  if (!exporter) {
-    ngx_log_error(NGX_LOG_ERR, cycle->log, 0, "Unable to create span exporter - invalid type");
-    return NGX_ERROR;
+  if (serviceName.empty()) {
+    serviceName = getEnvValue("OTEL_SERVICE_NAME", "unknown:nginx");
+  }
+
+  auto resource = opentelemetry::sdk::resource::Resource::Create({{"service.name", serviceName}});
+
+  std::unique_ptr<sdktrace::SpanProcessor> processor;
+
+  if (otelMainConf->spanRingZone) {
+    // Spans are written to shared memory as they end, the first worker exports them
+    // periodically and what is left when it exits.
+    processor.reset(new sdktrace::SimpleSpanProcessor(
+      CreateSpanRingExporter(otelMainConf->spanRingZone, &workerPipeline.exportedSpans)));
+
+    std::string endpoint = agentConf->exporter.endpoint;
+    if (endpoint.empty()) {
+      endpoint = otlp::OtlpHttpExporterOptions().url;
+    }
+
+    if (ngx_worker == 0 &&
+        !StartSpanRingExport(
+          otelMainConf->spanRingZone, cycle->log, endpoint, resource,
+          std::chrono::milliseconds(agentConf->processor.batch.scheduleDelayMillis),
+          agentConf->processor.batch.maxExportBatchSize,
+          std::chrono::milliseconds(agentConf->exporter.timeoutMillis))) {
+      ngx_log_error(NGX_LOG_ERR, cycle->log, 0, "Unable to start the shared span pipeline export");
+      return NGX_ERROR;
+    }
+  } else {
+    auto exporter = CreateExporter(agentConf);
+
+    if (!exporter) {
+      ngx_log_error(NGX_LOG_ERR, cycle->log, 0, "Unable to create span exporter - invalid type");
+      return NGX_ERROR;
+    }
+
+    processor = CreateProcessor(agentConf, std::unique_ptr<sdktrace::SpanExporter>(
+      new CountingSpanExporter(std::move(exporter), &workerPipeline.exportedSpans)));
   }
 
+  workerPipeline.processor = processor.get();
+
   auto sampler = CreateSampler(agentConf);
 
   if (!sampler) {
@@ -1365,24 +2245,60 @@ static ngx_int_t OtelNgxStart(ngx_cycle_t* cycle) {
     return NGX_ERROR;
   }
 
-  std::string serviceName = agentConf->service.name;
+  std::unique_ptr<OtelNgxIdGenerator> idGenerator(new OtelNgxIdGenerator());
+  workerPipeline.idGenerator = idGenerator.get();
 
-  if (serviceName.empty()) {
-    serviceName = getEnvValue("OTEL_SERVICE_NAME", "unknown:nginx");
-  }
-
-  auto processor = CreateProcessor(agentConf, std::move(exporter));
   auto provider =
     nostd::shared_ptr<opentelemetry::trace::TracerProvider>(new sdktrace::TracerProvider(
-      std::move(processor),
-      opentelemetry::sdk::resource::Resource::Create({{"service.name", serviceName}}),
-      std::move(sampler)));
+      std::move(processor), resource, std::move(sampler), std::move(idGenerator)));
 
   opentelemetry::trace::Provider::SetTracerProvider(std::move(provider));
 
+  if (otelMainConf->locationMetrics) {
+    StartRequestMetricsExport(
+      otelMainConf->locationMetrics, cycle->log, agentConf->metrics.endpoint, serviceName,
+      std::chrono::milliseconds(agentConf->metrics.intervalMillis));
+  }
+
   return NGX_OK;
 }
 
+static void OtelNgxExit(ngx_cycle_t* cycle) {
+  OtelMainConf* otelMainConf =
+    (OtelMainConf*)ngx_http_cycle_get_module_main_conf(cycle, otel_ngx_module);
+
+  // The span processor, the shared span pipeline and the request metrics share the budget.
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::microseconds budget =
+    std::chrono::milliseconds(otelMainConf->agentConfig.exitFlushTimeoutMillis);
+  auto remaining = [&]() {
+    auto left = budget - std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+    // A zero timeout would wait without limit.
+    return std::max(left, std::chrono::microseconds(1));
+  };
+
+  if (workerPipeline.processor) {
+    // The batch processor would otherwise drop the spans of the last schedule delay.
+    workerPipeline.processor->ForceFlush(budget);
+
+    // Shutdown still joins the batch processor thread, so it can run past the budget.
+    workerPipeline.processor->Shutdown(remaining());
+    workerPipeline.processor = nullptr;
+
+    uint64_t ended = workerPipeline.endedSpans.load();
+    uint64_t exported = workerPipeline.exportedSpans.load();
+    if (ended > exported) {
+      ngx_log_error(
+        NGX_LOG_WARN, cycle->log, 0, "opentelemetry: %uL of %uL spans were not exported by the exiting worker",
+        ended - exported, ended);
+    }
+  }
+
+  StopSpanRingExport(remaining());
+  StopRequestMetricsExport(remaining());
+}
+
 ngx_module_t otel_ngx_module = {
   NGX_MODULE_V1,
   &otel_ngx_http_module,
@@ -1393,7 +2309,7 @@ ngx_module_t otel_ngx_module = {
   OtelNgxStart, /* init process - worker process fork */
   nullptr,      /* init thread */
   nullptr,      /* exit thread */
-  nullptr,      /* exit process - worker process exit */
+  OtelNgxExit,  /* exit process - worker process exit */
   nullptr,      /* exit master */
   NGX_MODULE_V1_PADDING,
 };
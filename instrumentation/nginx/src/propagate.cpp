@@ -3,8 +3,10 @@
 #include "nginx_utils.h"
 #include <opentelemetry/context/context_value.h>
 #include <opentelemetry/trace/propagation/b3_propagator.h>
+#include <opentelemetry/trace/default_span.h>
 #include <opentelemetry/trace/propagation/http_trace_context.h>
 #include <opentelemetry/trace/span.h>
+#include <opentelemetry/trace/trace_state.h>
 
 namespace trace = opentelemetry::trace;
 namespace nostd = opentelemetry::nostd;
@@ -42,12 +44,69 @@ static bool FindHeader(ngx_http_request_t* req, nostd::string_view key, nostd::s
 }
 
 
+/*
+ * Propagation headers of the request, found in a single pass over the
+ * request headers instead of one pass per key the propagators ask for.
+ */
+struct PropagationHeaderIndex {
+  nostd::string_view traceparent;
+  nostd::string_view tracestate;
+  nostd::string_view b3;
+  nostd::string_view b3TraceId;
+  nostd::string_view b3SpanId;
+  nostd::string_view b3Sampled;
+};
+
+struct IndexedHeader {
+  nostd::string_view key;
+  nostd::string_view PropagationHeaderIndex::*value;
+};
+
+static const IndexedHeader kIndexedHeaders[] = {
+  {"traceparent", &PropagationHeaderIndex::traceparent},
+  {"tracestate", &PropagationHeaderIndex::tracestate},
+  {"b3", &PropagationHeaderIndex::b3},
+  {"x-b3-traceid", &PropagationHeaderIndex::b3TraceId},
+  {"x-b3-spanid", &PropagationHeaderIndex::b3SpanId},
+  {"x-b3-sampled", &PropagationHeaderIndex::b3Sampled},
+};
+
+static bool IsIndexedHeader(const IndexedHeader& indexed, ngx_str_t key) {
+  return indexed.key.size() == key.len &&
+         ngx_strncasecmp((u_char*)indexed.key.data(), key.data, key.len) == 0;
+}
+
+static void BuildPropagationHeaderIndex(ngx_http_request_t* req, PropagationHeaderIndex* index) {
+  for (ngx_list_part_t* part = &req->headers_in.headers.part; part != nullptr; part = part->next) {
+    ngx_table_elt_t* h = (ngx_table_elt_t*)part->elts;
+
+    for (ngx_uint_t i = 0; i < part->nelts; i++) {
+      for (const IndexedHeader& indexed : kIndexedHeaders) {
+        // The first header of a name wins, like FindHeader.
+        if (IsIndexedHeader(indexed, h[i].key) && (index->*indexed.value).empty()) {
+          index->*indexed.value = FromNgxString(h[i].value);
+          break;
+        }
+      }
+    }
+  }
+}
+
 class TextMapCarrierNgx : public opentelemetry::context::propagation::TextMapCarrier
 {
 public:
-  TextMapCarrierNgx(OtelCarrier* carrier) : carrier_(carrier) {}
+  TextMapCarrierNgx(OtelCarrier* carrier, const PropagationHeaderIndex* index = nullptr)
+    : carrier_(carrier), index_(index) {}
   virtual nostd::string_view Get(nostd::string_view key) const noexcept override
   {
+    if (index_) {
+      for (const IndexedHeader& indexed : kIndexedHeaders) {
+        if (IsIndexedHeader(indexed, ToNgxString(key))) {
+          return index_->*indexed.value;
+        }
+      }
+    }
+
     nostd::string_view value;
     FindHeader(carrier_->req, key, &value);
     return value;
@@ -58,8 +117,158 @@ class TextMapCarrierNgx : public opentelemetry::context::propagation::TextMapCar
   }
 
   OtelCarrier* carrier_;
+  const PropagationHeaderIndex* index_;
 };
 
+static int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+
+  return -1;
+}
+
+/*
+ * Decodes lowercase hex into the end of buffer, the start is zero padded.
+ * Returns false if the hex is longer than the buffer or not lowercase hex.
+ */
+static bool DecodeLowerHex(nostd::string_view hex, uint8_t* buffer, size_t size) {
+  if (hex.size() % 2 != 0 || hex.size() > 2 * size) {
+    return false;
+  }
+
+  size_t padding = size - hex.size() / 2;
+  ngx_memzero(buffer, padding);
+
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    int high = HexDigitValue(hex[i]);
+    int low = HexDigitValue(hex[i + 1]);
+
+    if (high < 0 || low < 0) {
+      return false;
+    }
+
+    buffer[padding + i / 2] = (uint8_t)((high << 4) | low);
+  }
+
+  return true;
+}
+
+static bool IsAllZero(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (buffer[i] != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static opentelemetry::context::Context
+WithRemoteSpan(const opentelemetry::context::Context& context, const trace::SpanContext& spanContext) {
+  return context.SetValue(
+    trace::kSpanKey, nostd::shared_ptr<trace::Span>(new trace::DefaultSpan(spanContext)));
+}
+
+/*
+ * Parses the common traceparent form, version 00 with lowercase hex, without
+ * going through the propagator. Returns false for anything else, which is
+ * left to HttpTraceContext.
+ */
+static bool ParseTraceparent(
+  nostd::string_view traceparent, nostd::string_view tracestate, trace::SpanContext* spanContext) {
+  // 00-<32 hex trace id>-<16 hex span id>-<2 hex flags>
+  if (
+    traceparent.size() != 55 || traceparent[0] != '0' || traceparent[1] != '0' ||
+    traceparent[2] != '-' || traceparent[35] != '-' || traceparent[52] != '-') {
+    return false;
+  }
+
+  uint8_t traceId[trace::TraceId::kSize];
+  uint8_t spanId[trace::SpanId::kSize];
+  uint8_t flags;
+
+  if (
+    !DecodeLowerHex(traceparent.substr(3, 32), traceId, sizeof(traceId)) ||
+    !DecodeLowerHex(traceparent.substr(36, 16), spanId, sizeof(spanId)) ||
+    !DecodeLowerHex(traceparent.substr(53, 2), &flags, sizeof(flags))) {
+    return false;
+  }
+
+  if (IsAllZero(traceId, sizeof(traceId)) || IsAllZero(spanId, sizeof(spanId))) {
+    return false;
+  }
+
+  *spanContext = trace::SpanContext(
+    trace::TraceId(traceId), trace::SpanId(spanId), trace::TraceFlags(flags), true,
+    trace::TraceState::FromHeader(tracestate));
+  return true;
+}
+
+/*
+ * Parses b3 ids of the common lengths, 16 or 32 hex trace id and 16 hex span
+ * id, without going through the propagator. Returns false for anything else,
+ * which is left to B3Propagator.
+ */
+static bool ParseB3Ids(
+  nostd::string_view traceIdHex, nostd::string_view spanIdHex, nostd::string_view sampled,
+  trace::SpanContext* spanContext) {
+  if ((traceIdHex.size() != 16 && traceIdHex.size() != 32) || spanIdHex.size() != 16) {
+    return false;
+  }
+
+  uint8_t traceId[trace::TraceId::kSize];
+  uint8_t spanId[trace::SpanId::kSize];
+
+  if (
+    !DecodeLowerHex(traceIdHex, traceId, sizeof(traceId)) ||
+    !DecodeLowerHex(spanIdHex, spanId, sizeof(spanId))) {
+    return false;
+  }
+
+  if (IsAllZero(traceId, sizeof(traceId)) || IsAllZero(spanId, sizeof(spanId))) {
+    return false;
+  }
+
+  bool isSampled = sampled.size() == 1 && (sampled[0] == '1' || sampled[0] == 'd');
+  *spanContext = trace::SpanContext(
+    trace::TraceId(traceId), trace::SpanId(spanId),
+    trace::TraceFlags(isSampled ? trace::TraceFlags::kIsSampled : 0), true);
+  return true;
+}
+
+/* Single b3 header: <trace id>-<span id>[-<sampled>], without parent span id. */
+static bool ParseB3(const PropagationHeaderIndex& index, trace::SpanContext* spanContext) {
+  if (index.b3.empty()) {
+    return ParseB3Ids(index.b3TraceId, index.b3SpanId, index.b3Sampled, spanContext);
+  }
+
+  nostd::string_view b3 = index.b3;
+  size_t traceIdEnd = b3.find('-');
+  if (traceIdEnd == nostd::string_view::npos) {
+    return false;
+  }
+
+  size_t spanIdEnd = b3.find('-', traceIdEnd + 1);
+  nostd::string_view sampled;
+  if (spanIdEnd == nostd::string_view::npos) {
+    spanIdEnd = b3.size();
+  } else {
+    sampled = b3.substr(spanIdEnd + 1);
+    if (sampled.size() != 1) {
+      return false;
+    }
+  }
+
+  return ParseB3Ids(
+    b3.substr(0, traceIdEnd), b3.substr(traceIdEnd + 1, spanIdEnd - traceIdEnd - 1), sampled,
+    spanContext);
+}
+
 TracePropagationType GetPropagationType(ngx_http_request_t* req) {
   OtelNgxLocationConf* config = GetOtelLocationConf(req);
   return config->propagationType;
@@ -67,15 +276,35 @@ TracePropagationType GetPropagationType(ngx_http_request_t* req) {
 
 opentelemetry::context::Context ExtractContext(OtelCarrier* carrier) {
   TracePropagationType propagationType = GetPropagationType(carrier->req);
-  TextMapCarrierNgx textMapCarrier(carrier);
+
+  PropagationHeaderIndex index;
+  BuildPropagationHeaderIndex(carrier->req, &index);
+  TextMapCarrierNgx textMapCarrier(carrier, &index);
 
   opentelemetry::context::Context root;
+  trace::SpanContext spanContext = trace::SpanContext::GetInvalid();
   switch (propagationType) {
     case TracePropagationW3C: {
+      if (index.traceparent.empty()) {
+        return root;
+      }
+
+      if (ParseTraceparent(index.traceparent, index.tracestate, &spanContext)) {
+        return WithRemoteSpan(root, spanContext);
+      }
+
       return OtelW3CPropagator().Extract(textMapCarrier, root);
     }
     case TracePropagationB3Multi:
     case TracePropagationB3: {
+      if (index.b3.empty() && index.b3TraceId.empty()) {
+        return root;
+      }
+
+      if (ParseB3(index, &spanContext)) {
+        return WithRemoteSpan(root, spanContext);
+      }
+
       return OtelB3Propagator().Extract(textMapCarrier, root);
     }
     default:
@@ -0,0 +1,262 @@
+#include "request_metrics.h"
+
+#include <opentelemetry/exporters/otlp/otlp_http_metric_exporter.h>
+#include <opentelemetry/exporters/otlp/otlp_http_metric_exporter_options.h>
+#include <opentelemetry/sdk/instrumentationscope/instrumentation_scope.h>
+#include <opentelemetry/sdk/metrics/data/metric_data.h>
+#include <opentelemetry/sdk/metrics/export/metric_producer.h>
+#include <opentelemetry/sdk/metrics/push_metric_exporter.h>
+#include <opentelemetry/sdk/resource/resource.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace metric_sdk = opentelemetry::sdk::metrics;
+namespace otlp = opentelemetry::exporter::otlp;
+
+using opentelemetry::common::SystemTimestamp;
+using opentelemetry::sdk::common::ExportResult;
+using opentelemetry::sdk::instrumentationscope::InstrumentationScope;
+using opentelemetry::sdk::resource::Resource;
+
+static bool NgxStrEqual(ngx_str_t a, ngx_str_t b) {
+  return a.len == b.len && ngx_strncmp(a.data, b.data, a.len) == 0;
+}
+
+OtelNgxLocationMetrics* OtelNgxBindLocationMetrics(
+  ngx_conf_t* cf, ngx_array_t** registry, ngx_str_t serverName, ngx_str_t location) {
+  if (!*registry) {
+    *registry = ngx_array_create(cf->pool, 4, sizeof(OtelNgxLocationMetrics*));
+
+    if (!*registry) {
+      return nullptr;
+    }
+  }
+
+  OtelNgxLocationMetrics** elements = (OtelNgxLocationMetrics**)(*registry)->elts;
+  for (ngx_uint_t i = 0; i < (*registry)->nelts; i++) {
+    if (NgxStrEqual(elements[i]->serverName, serverName) && NgxStrEqual(elements[i]->location, location)) {
+      return elements[i];
+    }
+  }
+
+  OtelNgxLocationMetrics** slot = (OtelNgxLocationMetrics**)ngx_array_push(*registry);
+  OtelNgxLocationMetrics* metrics =
+    (OtelNgxLocationMetrics*)ngx_pcalloc(cf->pool, sizeof(OtelNgxLocationMetrics));
+
+  if (!slot || !metrics) {
+    return nullptr;
+  }
+
+  new (metrics) OtelNgxLocationMetrics();
+  metrics->serverName = serverName;
+  metrics->location = location;
+  *slot = metrics;
+
+  return metrics;
+}
+
+void OtelNgxRecordRequest(OtelNgxLocationMetrics* metrics, ngx_msec_t durationMillis, bool error) {
+  // Buckets are inclusive of their upper bound.
+  size_t bucket = std::lower_bound(
+    std::begin(kOtelNgxDurationBoundaries), std::end(kOtelNgxDurationBoundaries),
+    (double)durationMillis) - std::begin(kOtelNgxDurationBoundaries);
+
+  metrics->requests.fetch_add(1, std::memory_order_relaxed);
+  if (error) {
+    metrics->errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  metrics->durationSumMillis.fetch_add(durationMillis, std::memory_order_relaxed);
+  metrics->durationBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+static metric_sdk::MetricData CreateMetricData(
+  const char* name, const char* description, const char* unit, metric_sdk::InstrumentType type,
+  metric_sdk::InstrumentValueType valueType, SystemTimestamp start, SystemTimestamp end) {
+  metric_sdk::MetricData data;
+  data.instrument_descriptor =
+    metric_sdk::InstrumentDescriptor{name, description, unit, type, valueType};
+  data.aggregation_temporality = metric_sdk::AggregationTemporality::kCumulative;
+  data.start_ts = start;
+  data.end_ts = end;
+  return data;
+}
+
+static metric_sdk::SumPointData CreateSumPoint(uint64_t value) {
+  metric_sdk::SumPointData point;
+  point.value_ = (int64_t)value;
+  point.is_monotonic_ = true;
+  return point;
+}
+
+class RequestMetricsExport {
+public:
+  RequestMetricsExport(
+    ngx_array_t* registry, ngx_log_t* log, const std::string& endpoint,
+    const std::string& serviceName, std::chrono::milliseconds interval)
+    : registry_(registry), log_(log), interval_(interval),
+      // Every worker exports cumulative series of its own.
+      resource_(Resource::Create({{"service.name", serviceName}, {"process.pid", (int64_t)ngx_pid}})),
+      scope_(InstrumentationScope::Create("nginx")),
+      start_(std::chrono::system_clock::now()) {
+    otlp::OtlpHttpMetricExporterOptions opts;
+    opts.url = endpoint.empty() ? opts.url : endpoint;
+    exporter_.reset(new otlp::OtlpHttpMetricExporter(opts));
+  }
+
+  ~RequestMetricsExport() {
+    Stop(std::chrono::microseconds::zero());
+    exporter_->Shutdown();
+  }
+
+  void Start() {
+    thread_ = std::thread(&RequestMetricsExport::Run, this);
+  }
+
+  /*
+   * Stops the thread, after its last export. The export is aborted, and the
+   * aggregators dropped, when it does not complete within timeout.
+   */
+  void Stop(std::chrono::microseconds timeout) {
+    if (!thread_.joinable()) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    cv_.notify_all();
+    bool exported = cv_.wait_for(lock, timeout, [this] { return done_; });
+    lock.unlock();
+
+    if (!exported) {
+      // Cancels the request in flight.
+      exporter_->Shutdown();
+      ngx_log_error(
+        NGX_LOG_WARN, log_, 0,
+        "opentelemetry: request metrics of the exiting worker were dropped, "
+        "the export did not complete in time");
+    }
+
+    thread_.join();
+  }
+
+private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stop_) {
+      cv_.wait_for(lock, interval_, [this] { return stop_; });
+
+      lock.unlock();
+      Export();
+      lock.lock();
+    }
+
+    done_ = true;
+    cv_.notify_all();
+  }
+
+  void Export() {
+    SystemTimestamp now(std::chrono::system_clock::now());
+
+    metric_sdk::MetricData requests = CreateMetricData(
+      "nginx.location.requests", "Requests served by the location", "{request}",
+      metric_sdk::InstrumentType::kCounter, metric_sdk::InstrumentValueType::kLong, start_, now);
+    metric_sdk::MetricData errors = CreateMetricData(
+      "nginx.location.errors", "Requests of the location answered with a 5xx status", "{request}",
+      metric_sdk::InstrumentType::kCounter, metric_sdk::InstrumentValueType::kLong, start_, now);
+    metric_sdk::MetricData duration = CreateMetricData(
+      "nginx.location.duration", "Duration of the requests of the location", "ms",
+      metric_sdk::InstrumentType::kHistogram, metric_sdk::InstrumentValueType::kDouble, start_, now);
+
+    OtelNgxLocationMetrics** elements = (OtelNgxLocationMetrics**)registry_->elts;
+    for (ngx_uint_t i = 0; i < registry_->nelts; i++) {
+      OtelNgxLocationMetrics* metrics = elements[i];
+      uint64_t requestCount = metrics->requests.load(std::memory_order_relaxed);
+
+      if (requestCount == 0) {
+        continue;
+      }
+
+      metric_sdk::PointAttributes attributes{
+        {"nginx.server_name",
+         std::string((const char*)metrics->serverName.data, metrics->serverName.len)},
+        {"nginx.location", std::string((const char*)metrics->location.data, metrics->location.len)}};
+
+      requests.point_data_attr_.push_back({attributes, CreateSumPoint(requestCount)});
+      errors.point_data_attr_.push_back(
+        {attributes, CreateSumPoint(metrics->errors.load(std::memory_order_relaxed))});
+
+      // The worker keeps recording, the count is the sum of the buckets read.
+      metric_sdk::HistogramPointData histogram;
+      histogram.boundaries_.assign(
+        std::begin(kOtelNgxDurationBoundaries), std::end(kOtelNgxDurationBoundaries));
+      histogram.counts_.resize(kOtelNgxDurationBuckets);
+      histogram.count_ = 0;
+      for (size_t bucket = 0; bucket < kOtelNgxDurationBuckets; bucket++) {
+        histogram.counts_[bucket] = metrics->durationBuckets[bucket].load(std::memory_order_relaxed);
+        histogram.count_ += histogram.counts_[bucket];
+      }
+      histogram.sum_ = (double)metrics->durationSumMillis.load(std::memory_order_relaxed);
+      histogram.record_min_max_ = false;
+
+      duration.point_data_attr_.push_back({attributes, histogram});
+    }
+
+    if (requests.point_data_attr_.empty()) {
+      return;
+    }
+
+    metric_sdk::ScopeMetrics scopeMetrics;
+    scopeMetrics.scope_ = scope_.get();
+    scopeMetrics.metric_data_.push_back(std::move(requests));
+    scopeMetrics.metric_data_.push_back(std::move(errors));
+    scopeMetrics.metric_data_.push_back(std::move(duration));
+
+    metric_sdk::ResourceMetrics data;
+    data.resource_ = &resource_;
+    data.scope_metric_data_.push_back(std::move(scopeMetrics));
+
+    if (exporter_->Export(data) != ExportResult::kSuccess) {
+      ngx_log_error(NGX_LOG_ERR, log_, 0, "opentelemetry: request metrics export failed");
+    }
+  }
+
+  ngx_array_t* registry_;
+  ngx_log_t* log_;
+  std::chrono::milliseconds interval_;
+  Resource resource_;
+  std::unique_ptr<InstrumentationScope> scope_;
+  SystemTimestamp start_;
+  std::unique_ptr<metric_sdk::PushMetricExporter> exporter_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  /* Set by the thread once its last export completed. */
+  bool done_ = false;
+  std::thread thread_;
+};
+
+static std::unique_ptr<RequestMetricsExport> requestMetricsExport;
+
+void StartRequestMetricsExport(
+  ngx_array_t* registry, ngx_log_t* log, const std::string& endpoint,
+  const std::string& serviceName, std::chrono::milliseconds interval) {
+  requestMetricsExport.reset(
+    new RequestMetricsExport(registry, log, endpoint, serviceName, interval));
+  requestMetricsExport->Start();
+}
+
+void StopRequestMetricsExport(std::chrono::microseconds timeout) {
+  if (requestMetricsExport) {
+    requestMetricsExport->Stop(timeout);
+    requestMetricsExport.reset();
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include <ngx_config.h>
+#include <ngx_core.h>
+}
+
+/*
+ * Request, error and duration (RED) metrics of the locations with
+ * opentelemetry_metrics on. The aggregators are bound to the location
+ * configurations when nginx reads its configuration, so every worker inherits
+ * its own copy: the worker updates them without locks and a thread of the
+ * worker exports them periodically.
+ */
+
+/* Upper bounds of the request duration histogram buckets, in milliseconds. */
+constexpr double kOtelNgxDurationBoundaries[] = {
+  5, 10, 25, 50, 75, 100, 250, 500, 750, 1000, 2500, 5000, 7500, 10000,
+};
+
+constexpr size_t kOtelNgxDurationBuckets =
+  sizeof(kOtelNgxDurationBoundaries) / sizeof(kOtelNgxDurationBoundaries[0]) + 1;
+
+struct OtelNgxLocationMetrics {
+  /* Values of the nginx.server_name and nginx.location attributes. */
+  ngx_str_t serverName;
+  ngx_str_t location;
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> durationSumMillis{0};
+  std::atomic<uint64_t> durationBuckets[kOtelNgxDurationBuckets] = {};
+};
+
+/*
+ * Returns the aggregator of location in the server named serverName,
+ * registering it in registry (an array of OtelNgxLocationMetrics*) on first
+ * use. Locations of a server sharing a name, like the if blocks of a location,
+ * share their aggregator.
+ */
+OtelNgxLocationMetrics* OtelNgxBindLocationMetrics(
+  ngx_conf_t* cf, ngx_array_t** registry, ngx_str_t serverName, ngx_str_t location);
+
+/* Records a finished request, called by the worker only. */
+void OtelNgxRecordRequest(OtelNgxLocationMetrics* metrics, ngx_msec_t durationMillis, bool error);
+
+/*
+ * Starts a thread of the current process exporting the aggregators of
+ * registry to the OTLP/HTTP endpoint every interval.
+ */
+void StartRequestMetricsExport(
+  ngx_array_t* registry, ngx_log_t* log, const std::string& endpoint,
+  const std::string& serviceName, std::chrono::milliseconds interval);
+
+/*
+ * Stops the thread, after exporting the aggregators a last time. The export
+ * is aborted when it does not complete within timeout.
+ */
+void StopRequestMetricsExport(std::chrono::microseconds timeout);
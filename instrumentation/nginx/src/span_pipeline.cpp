@@ -0,0 +1,500 @@
+#include "span_pipeline.h"
+
+#include <opentelemetry/exporters/otlp/otlp_populate_attribute_utils.h>
+#include <opentelemetry/exporters/otlp/otlp_recordable.h>
+
+#include <opentelemetry/exporters/otlp/protobuf_include_prefix.h>
+#include <opentelemetry/proto/common/v1/common.pb.h>
+#include <opentelemetry/proto/resource/v1/resource.pb.h>
+#include <opentelemetry/proto/trace/v1/trace.pb.h>
+#include <opentelemetry/exporters/otlp/protobuf_include_suffix.h>
+
+#include <curl/curl.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace nostd = opentelemetry::nostd;
+namespace sdktrace = opentelemetry::sdk::trace;
+namespace otlp = opentelemetry::exporter::otlp;
+
+using opentelemetry::sdk::common::ExportResult;
+
+/*
+ * Records are an OtelNgxSpanRecord followed by the spans, serialized as the
+ * spans field of a ScopeSpans message. Every worker has the same resource and
+ * scope, the exporting process wraps concatenated records in a single
+ * ResourceSpans without decoding them.
+ */
+struct OtelNgxSpanRecord {
+  /* Bytes following the header. */
+  uint32_t len;
+  uint32_t spans;
+};
+
+struct OtelNgxSpanRing {
+  size_t capacity;
+  /* Offset of the oldest record. */
+  size_t head;
+  /* Bytes used by the records. */
+  size_t used;
+  /* Spans dropped because the ring was full or their export failed. */
+  ngx_atomic_t dropped;
+  u_char data[1];
+};
+
+static void AppendVarint(std::string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back((char)value);
+}
+
+/* Appends the key and length of a length-delimited protobuf field. */
+static void AppendFieldHeader(std::string* out, uint32_t field, size_t len) {
+  AppendVarint(out, (field << 3) | 2);
+  AppendVarint(out, len);
+}
+
+static void AppendField(std::string* out, uint32_t field, const std::string& bytes) {
+  AppendFieldHeader(out, field, bytes.size());
+  out->append(bytes);
+}
+
+static ngx_slab_pool_t* GetSpanRingPool(ngx_shm_zone_t* zone) {
+  return (ngx_slab_pool_t*)zone->shm.addr;
+}
+
+ngx_int_t OtelNgxInitSpanRing(ngx_shm_zone_t* zone, void* data) {
+  if (data) {
+    zone->data = data;
+    return NGX_OK;
+  }
+
+  ngx_slab_pool_t* shpool = GetSpanRingPool(zone);
+
+  if (zone->shm.exists) {
+    zone->data = shpool->data;
+    return NGX_OK;
+  }
+
+  // The slab pool keeps its own bookkeeping at the start of the zone.
+  size_t capacity = zone->shm.size - zone->shm.size / 8;
+  OtelNgxSpanRing* ring =
+    (OtelNgxSpanRing*)ngx_slab_alloc(shpool, sizeof(OtelNgxSpanRing) + capacity);
+
+  if (!ring) {
+    return NGX_ERROR;
+  }
+
+  ring->capacity = capacity;
+  ring->head = 0;
+  ring->used = 0;
+  ring->dropped = 0;
+
+  shpool->data = ring;
+  zone->data = ring;
+
+  return NGX_OK;
+}
+
+static void RingCopyIn(OtelNgxSpanRing* ring, size_t offset, const void* src, size_t len) {
+  offset %= ring->capacity;
+  size_t first = std::min(len, ring->capacity - offset);
+
+  ngx_memcpy(ring->data + offset, src, first);
+  ngx_memcpy(ring->data, (const u_char*)src + first, len - first);
+}
+
+static void RingCopyOut(const OtelNgxSpanRing* ring, size_t offset, void* dst, size_t len) {
+  offset %= ring->capacity;
+  size_t first = std::min(len, ring->capacity - offset);
+
+  ngx_memcpy(dst, ring->data + offset, first);
+  ngx_memcpy((u_char*)dst + first, ring->data, len - first);
+}
+
+static bool RingPush(
+  ngx_slab_pool_t* shpool, OtelNgxSpanRing* ring, const std::string& record, size_t spans) {
+  OtelNgxSpanRecord header = {(uint32_t)record.size(), (uint32_t)spans};
+  size_t recordSize = sizeof(header) + header.len;
+
+  ngx_shmtx_lock(&shpool->mutex);
+
+  bool fits = recordSize <= ring->capacity - ring->used;
+  if (fits) {
+    size_t tail = ring->head + ring->used;
+    RingCopyIn(ring, tail, &header, sizeof(header));
+    RingCopyIn(ring, tail + sizeof(header), record.data(), header.len);
+    ring->used += recordSize;
+  }
+
+  ngx_shmtx_unlock(&shpool->mutex);
+
+  return fits;
+}
+
+/*
+ * Appends records to batch until it holds maxSpans spans, always moving at
+ * least one record. Returns the number of bytes moved, headers included, and
+ * adds the spans moved to *spans.
+ */
+static size_t RingPop(
+  ngx_slab_pool_t* shpool, OtelNgxSpanRing* ring, size_t maxSpans, std::string* batch,
+  size_t* spans) {
+  size_t moved = 0;
+
+  ngx_shmtx_lock(&shpool->mutex);
+
+  while (ring->used > 0 && (moved == 0 || *spans < maxSpans)) {
+    OtelNgxSpanRecord header;
+    RingCopyOut(ring, ring->head, &header, sizeof(header));
+
+    if (moved > 0 && *spans + header.spans > maxSpans) {
+      break;
+    }
+
+    size_t offset = batch->size();
+    batch->resize(offset + header.len);
+    RingCopyOut(ring, ring->head + sizeof(header), &(*batch)[offset], header.len);
+
+    ring->head = (ring->head + sizeof(header) + header.len) % ring->capacity;
+    ring->used -= sizeof(header) + header.len;
+    moved += sizeof(header) + header.len;
+    *spans += header.spans;
+  }
+
+  ngx_shmtx_unlock(&shpool->mutex);
+
+  return moved;
+}
+
+/* Discards every record of the ring. Returns the number of spans discarded. */
+static size_t RingDiscard(ngx_slab_pool_t* shpool, OtelNgxSpanRing* ring) {
+  size_t spans = 0;
+
+  ngx_shmtx_lock(&shpool->mutex);
+
+  while (ring->used > 0) {
+    OtelNgxSpanRecord header;
+    RingCopyOut(ring, ring->head, &header, sizeof(header));
+
+    ring->head = (ring->head + sizeof(header) + header.len) % ring->capacity;
+    ring->used -= sizeof(header) + header.len;
+    spans += header.spans;
+  }
+
+  ngx_shmtx_unlock(&shpool->mutex);
+
+  return spans;
+}
+
+class SpanRingExporter final : public sdktrace::SpanExporter {
+public:
+  SpanRingExporter(ngx_slab_pool_t* shpool, OtelNgxSpanRing* ring, std::atomic<uint64_t>* queuedSpans)
+    : shpool_(shpool), ring_(ring), queuedSpans_(queuedSpans) {}
+
+  std::unique_ptr<sdktrace::Recordable> MakeRecordable() noexcept override {
+    return std::unique_ptr<sdktrace::Recordable>(new otlp::OtlpRecordable());
+  }
+
+  ExportResult Export(
+    const nostd::span<std::unique_ptr<sdktrace::Recordable>>& spans) noexcept override {
+    record_.clear();
+
+    // The resource and scope are added by the exporting process.
+    for (auto& recordable : spans) {
+      const auto& span = static_cast<otlp::OtlpRecordable*>(recordable.get())->span();
+      size_t size = span.ByteSizeLong();
+
+      AppendFieldHeader(&record_, 2, size);
+      size_t offset = record_.size();
+      record_.resize(offset + size);
+
+      if (!span.SerializeToArray(&record_[offset], (int)size)) {
+        return ExportResult::kFailure;
+      }
+    }
+
+    // A full ring is reported by the exporting process, not on every span.
+    if (!RingPush(shpool_, ring_, record_, spans.size())) {
+      ngx_atomic_fetch_add(&ring_->dropped, spans.size());
+      return ExportResult::kSuccess;
+    }
+
+    queuedSpans_->fetch_add(spans.size(), std::memory_order_relaxed);
+    return ExportResult::kSuccess;
+  }
+
+  bool ForceFlush(std::chrono::microseconds) noexcept override { return true; }
+
+  bool Shutdown(std::chrono::microseconds) noexcept override { return true; }
+
+private:
+  ngx_slab_pool_t* shpool_;
+  OtelNgxSpanRing* ring_;
+  std::atomic<uint64_t>* queuedSpans_;
+  /* Serialization buffer, reused between spans. */
+  std::string record_;
+};
+
+std::unique_ptr<sdktrace::SpanExporter> CreateSpanRingExporter(
+  ngx_shm_zone_t* zone, std::atomic<uint64_t>* queuedSpans) {
+  return std::unique_ptr<sdktrace::SpanExporter>(
+    new SpanRingExporter(GetSpanRingPool(zone), (OtelNgxSpanRing*)zone->data, queuedSpans));
+}
+
+static size_t DiscardResponse(char*, size_t size, size_t nmemb, void*) {
+  return size * nmemb;
+}
+
+class SpanRingExport {
+public:
+  SpanRingExport(
+    ngx_shm_zone_t* zone, ngx_log_t* log, const std::string& endpoint,
+    const opentelemetry::sdk::resource::Resource& resource, std::chrono::milliseconds delay,
+    size_t maxBatchSpans, std::chrono::milliseconds timeout)
+    : shpool_(GetSpanRingPool(zone)), ring_((OtelNgxSpanRing*)zone->data), log_(log),
+      endpoint_(endpoint), delay_(delay), maxBatchSpans_(std::max<size_t>(1, maxBatchSpans)),
+      timeout_(timeout) {
+    opentelemetry::proto::resource::v1::Resource resourceProto;
+    otlp::OtlpPopulateAttributeUtils::PopulateAttribute(&resourceProto, resource);
+    AppendField(&resourceField_, 1, resourceProto.SerializeAsString());
+
+    opentelemetry::proto::common::v1::InstrumentationScope scopeProto;
+    scopeProto.set_name("nginx");
+    AppendField(&scopeField_, 1, scopeProto.SerializeAsString());
+  }
+
+  ~SpanRingExport() {
+    Stop(std::chrono::microseconds::zero());
+
+    if (headers_) {
+      curl_slist_free_all(headers_);
+    }
+
+    if (curl_) {
+      curl_easy_cleanup(curl_);
+    }
+  }
+
+  bool Start() {
+    curl_ = curl_easy_init();
+    headers_ = curl_slist_append(nullptr, "Content-Type: application/x-protobuf");
+
+    if (!curl_ || !headers_) {
+      return false;
+    }
+
+    thread_ = std::thread(&SpanRingExport::Run, this);
+
+    return true;
+  }
+
+  /*
+   * Stops the thread, then exports what the ring holds until timeout. The
+   * export in flight is aborted when the timeout expires, and the spans left
+   * in the ring are dropped.
+   */
+  void Stop(std::chrono::microseconds timeout) {
+    if (stopped_) {
+      return;
+    }
+    stopped_ = true;
+
+    deadline_.store(
+      (Clock::now() + timeout).time_since_epoch().count(), std::memory_order_relaxed);
+
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+
+    if (curl_ && headers_) {
+      ExportRing();
+    }
+
+    if (Expired()) {
+      size_t left = RingDiscard(shpool_, ring_);
+      if (left != 0) {
+        ngx_atomic_fetch_add(&ring_->dropped, left);
+        ReportDroppedSpans();
+      }
+    }
+  }
+
+private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!cv_.wait_for(lock, delay_, [this] { return stop_; })) {
+      lock.unlock();
+      ExportRing();
+      lock.lock();
+    }
+  }
+
+  using Clock = std::chrono::steady_clock;
+
+  bool Expired() const {
+    return Clock::now().time_since_epoch().count() > deadline_.load(std::memory_order_relaxed);
+  }
+
+  /* Aborts the transfer in flight once the stop timeout expired. */
+  static int AbortExpired(void* self, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return ((SpanRingExport*)self)->Expired() ? 1 : 0;
+  }
+
+  /*
+   * Exports the spans queued when called, until the stop timeout expires.
+   * Stops at the first failure, the spans of the failed request are dropped.
+   */
+  void ExportRing() {
+    ngx_shmtx_lock(&shpool_->mutex);
+    size_t queued = ring_->used;
+    ngx_shmtx_unlock(&shpool_->mutex);
+
+    size_t exported = 0;
+    while (exported < queued && !Expired()) {
+      size_t spans = 0;
+      size_t moved = RingPop(shpool_, ring_, maxBatchSpans_, &batch_, &spans);
+      if (moved == 0) {
+        break;
+      }
+
+      exported += moved;
+      bool ok = Post(BuildRequest());
+      batch_.clear();
+
+      if (!ok) {
+        ngx_atomic_fetch_add(&ring_->dropped, spans);
+        break;
+      }
+    }
+
+    ReportDroppedSpans();
+  }
+
+  /* Wraps the spans of batch_ in a request with the resource and scope of the workers. */
+  const std::string& BuildRequest() {
+    scopeSpans_.assign(scopeField_);
+    scopeSpans_.append(batch_);
+
+    resourceSpans_.assign(resourceField_);
+    AppendField(&resourceSpans_, 2, scopeSpans_);
+
+    request_.clear();
+    AppendField(&request_, 1, resourceSpans_);
+
+    return request_;
+  }
+
+  void ReportDroppedSpans() {
+    // Every exiting worker exports the ring, the count is reset by the one reporting it.
+    ngx_atomic_uint_t dropped = ring_->dropped;
+
+    while (dropped != 0 && !ngx_atomic_cmp_set(&ring_->dropped, dropped, 0)) {
+      dropped = ring_->dropped;
+    }
+
+    if (dropped != 0) {
+      ngx_log_error(
+        NGX_LOG_WARN, log_, 0,
+        "opentelemetry: %uA spans dropped by the shared span pipeline, "
+        "the zone was full or the export failed",
+        dropped);
+    }
+  }
+
+  bool Post(const std::string& body) {
+    curl_easy_reset(curl_);
+    curl_easy_setopt(curl_, CURLOPT_URL, endpoint_.c_str());
+    curl_easy_setopt(curl_, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)body.size());
+    curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers_);
+    curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, DiscardResponse);
+    curl_easy_setopt(curl_, CURLOPT_TIMEOUT_MS, (long)timeout_.count());
+    curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, AbortExpired);
+    curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, this);
+
+    CURLcode rc = curl_easy_perform(curl_);
+    long status = 0;
+    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+
+    if (rc != CURLE_OK || status < 200 || status >= 300) {
+      ngx_log_error(
+        NGX_LOG_ERR, log_, 0, "opentelemetry: span export to %s failed: %s, HTTP status %l",
+        endpoint_.c_str(), curl_easy_strerror(rc), status);
+      return false;
+    }
+
+    return true;
+  }
+
+  ngx_slab_pool_t* shpool_;
+  OtelNgxSpanRing* ring_;
+  ngx_log_t* log_;
+  std::string endpoint_;
+  std::chrono::milliseconds delay_;
+  size_t maxBatchSpans_;
+  std::chrono::milliseconds timeout_;
+  /* Serialized resource field of ResourceSpans and scope field of ScopeSpans. */
+  std::string resourceField_;
+  std::string scopeField_;
+
+  CURL* curl_ = nullptr;
+  curl_slist* headers_ = nullptr;
+  /* Buffers reused between requests. */
+  std::string batch_;
+  std::string scopeSpans_;
+  std::string resourceSpans_;
+  std::string request_;
+
+  /* Stop deadline, as a count of Clock ticks. */
+  std::atomic<Clock::rep> deadline_{Clock::duration::max().count()};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+  /* Set by the first Stop, later calls do nothing. */
+  bool stopped_ = false;
+};
+
+static std::unique_ptr<SpanRingExport> spanRingExport;
+
+bool StartSpanRingExport(
+  ngx_shm_zone_t* zone, ngx_log_t* log, const std::string& endpoint,
+  const opentelemetry::sdk::resource::Resource& resource, std::chrono::milliseconds delay,
+  size_t maxBatchSpans, std::chrono::milliseconds timeout) {
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  spanRingExport.reset(
+    new SpanRingExport(zone, log, endpoint, resource, delay, maxBatchSpans, timeout));
+
+  if (!spanRingExport->Start()) {
+    spanRingExport.reset();
+    return false;
+  }
+
+  return true;
+}
+
+void StopSpanRingExport(std::chrono::microseconds timeout) {
+  if (spanRingExport) {
+    spanRingExport->Stop(timeout);
+    spanRingExport.reset();
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <opentelemetry/sdk/resource/resource.h>
+#include <opentelemetry/sdk/trace/exporter.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <ngx_config.h>
+#include <ngx_core.h>
+}
+
+/*
+ * Shared span pipeline: the workers write their finished spans, serialized as
+ * OTLP protobuf, into a ring buffer in a shared memory zone. A single process
+ * batches and exports them, instead of every worker running its own batch
+ * processor and exporter.
+ */
+
+/* Init handler of the shared memory zone. Queued spans are kept on reload. */
+ngx_int_t OtelNgxInitSpanRing(ngx_shm_zone_t* zone, void* data);
+
+/*
+ * Span exporter of the workers, writing into the ring of the zone. The spans
+ * written are added to queuedSpans, the spans dropped because the ring is full
+ * are not.
+ */
+std::unique_ptr<opentelemetry::sdk::trace::SpanExporter>
+CreateSpanRingExporter(ngx_shm_zone_t* zone, std::atomic<uint64_t>* queuedSpans);
+
+/*
+ * Starts a thread of the current process exporting the ring to endpoint every
+ * delay, in requests of at most maxBatchSpans spans with the given resource.
+ * Only one process exports the ring.
+ */
+bool StartSpanRingExport(
+  ngx_shm_zone_t* zone, ngx_log_t* log, const std::string& endpoint,
+  const opentelemetry::sdk::resource::Resource& resource, std::chrono::milliseconds delay,
+  size_t maxBatchSpans, std::chrono::milliseconds timeout);
+
+/*
+ * Stops the thread, if any, then exports what the ring holds for at most
+ * timeout. The spans still queued after timeout are counted as dropped.
+ */
+void StopSpanRingExport(std::chrono::microseconds timeout);
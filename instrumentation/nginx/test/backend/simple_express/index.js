@@ -54,6 +54,10 @@ app.get("/off", (req, res) => {
   res.json({});
 });
 
+app.get("/slow", (req, res) => {
+  setTimeout(() => res.json({}), 500);
+});
+
 const server = app.listen(port, () => {
   console.log(`simple_express ready at http://localhost:${port}`)
 });
@@ -2,23 +2,28 @@ defmodule InstrumentationTest do
   use ExUnit.Case
 
   @host "localhost:8080"
+  @shared_host "localhost:8081"
+  @unreachable_host "localhost:8082"
+  @deferred_host "localhost:8083"
+  @json_host "localhost:8084"
   @collector_healthcheck "localhost:13133"
   @traces_path "../data/trace.json"
+  @metrics_path "../data/metrics.json"
 
   def has_line(lines, re) do
     Enum.find(lines, fn line -> String.match?(line, re) end) != nil
   end
 
-  def poll_nginx(0), do: raise("Timed out waiting for nginx")
+  def poll_nginx(_host, 0), do: raise("Timed out waiting for nginx")
 
-  def poll_nginx(attempts_remaining) do
-    case HTTPoison.get("#{@host}/up") do
+  def poll_nginx(host, attempts_remaining) do
+    case HTTPoison.get("#{host}/up") do
       {:ok, %HTTPoison.Response{status_code: 200}} ->
         :ready
 
       _ ->
         Process.sleep(200)
-        poll_nginx(attempts_remaining - 1)
+        poll_nginx(host, attempts_remaining - 1)
     end
   end
 
@@ -36,7 +41,11 @@ defmodule InstrumentationTest do
   end
 
   def wait_nginx() do
-    poll_nginx(30)
+    poll_nginx(@host, 30)
+    poll_nginx(@shared_host, 30)
+    poll_nginx(@unreachable_host, 30)
+    poll_nginx(@deferred_host, 30)
+    poll_nginx(@json_host, 30)
   end
 
   def wait_collector() do
@@ -79,6 +88,51 @@ defmodule InstrumentationTest do
     scope_spans["spans"]
   end
 
+  def read_span_traces(_file, num_spans, traces) when num_spans <= 0, do: traces
+
+  def read_span_traces(file, num_spans, traces) do
+    [trace] = read_traces(file, 1)
+    read_span_traces(file, num_spans - length(collect_spans(trace)), [trace | traces])
+  end
+
+  def metric_points(metrics, name) do
+    metrics["resourceMetrics"]
+    |> Enum.flat_map(fn resource_metrics -> resource_metrics["scopeMetrics"] end)
+    |> Enum.flat_map(fn scope_metrics -> scope_metrics["metrics"] end)
+    |> Enum.filter(fn metric -> metric["name"] == name end)
+    |> Enum.flat_map(fn metric -> (metric["sum"] || metric["histogram"])["dataPoints"] end)
+  end
+
+  def read_metrics(_file, _match, timeout) when timeout <= 0,
+    do: raise("timed out waiting for metrics")
+
+  def read_metrics(file, match, timeout) do
+    case IO.read(file, :line) do
+      :eof ->
+        Process.sleep(100)
+        read_metrics(file, match, timeout - 100)
+
+      line ->
+        metrics = Jason.decode!(line)
+
+        if match.(metrics) do
+          metrics
+        else
+          read_metrics(file, match, timeout)
+        end
+    end
+  end
+
+  def read_metric_point(file, name, match) do
+    metrics = read_metrics(file, fn m -> Enum.any?(metric_points(m, name), match) end, 5_000)
+    Enum.find(metric_points(metrics, name), match)
+  end
+
+  def location_point?(point, server_name, location) do
+    attrib(point, "nginx.server_name") == server_name and
+      attrib(point, "nginx.location") == location
+  end
+
   def values(map) do
     Enum.map(map, fn {k, v} ->
       case k do
@@ -120,8 +174,45 @@ defmodule InstrumentationTest do
     read_until_eof(file, [])
   end
 
+  # Runs `nginx -t` on an http block holding the directive, returns the output and exit status.
+  def nginx_config_test(directive) do
+    path = Path.expand("../conf/nginx_invalid.conf")
+
+    File.write!(path, """
+    load_module /otel-nginx/install/otel_ngx_module.so;
+    events {}
+    http {
+      #{directive};
+    }
+    """)
+
+    try do
+      System.cmd(
+        "docker",
+        [
+          "compose",
+          "run",
+          "--rm",
+          "--no-deps",
+          "-T",
+          "-v",
+          "#{path}:/otel-nginx/invalid.conf",
+          "nginx-json",
+          "/nginx/sbin/nginx",
+          "-t",
+          "-c",
+          "/otel-nginx/invalid.conf"
+        ],
+        stderr_to_stdout: true
+      )
+    after
+      File.rm(path)
+    end
+  end
+
   setup_all do
     File.chmod!(@traces_path, 0o666)
+    File.chmod!(@metrics_path, 0o666)
     port = Port.open({:spawn, "docker compose up"}, [:binary])
 
     on_exit(fn ->
@@ -241,6 +332,28 @@ defmodule InstrumentationTest do
     assert attrib(span, "http.response.header.bar") == ["[REDACTED]"]
   end
 
+  test "location with opentelemetry_capture_headers_allowlist should only capture listed headers",
+       %{trace_file: trace_file} do
+    %HTTPoison.Response{status_code: status} =
+      HTTPoison.get!("#{@host}/capture_headers_allowlist", [
+        {"x-REQUEST-id", "Request-Id-Value"},
+        {"Authorization", "Bearer secret"},
+        {"Not-Listed", "Not-Listed-Value"}
+      ])
+
+    [trace] = read_traces(trace_file, 1)
+    [span] = collect_spans(trace)
+
+    assert status == 200
+
+    assert attrib(span, "http.request.header.x_request_id") == ["Request-Id-Value"]
+    assert attrib(span, "http.request.header.authorization") == ["[REDACTED]"]
+    assert attrib(span, "http.request.header.not_listed") == nil
+    assert attrib(span, "http.request.header.host") == nil
+    assert attrib(span, "http.response.header.response_header") == ["Response-Value"]
+    assert attrib(span, "http.response.header.other_response_header") == nil
+  end
+
   test "location without operation name should use operation name from server", %{
     trace_file: trace_file
   } do
@@ -292,6 +405,108 @@ defmodule InstrumentationTest do
     test_parent_span(@host, ctx)
   end
 
+  def assert_extracted(url, headers, trace_id, parent_span_id, %{trace_file: trace_file}) do
+    %HTTPoison.Response{status_code: status} = HTTPoison.get!(url, headers)
+
+    [trace] = read_traces(trace_file, 1)
+    [span] = collect_spans(trace)
+
+    assert status == 200
+    assert span["traceId"] == trace_id
+    assert span["parentSpanId"] == parent_span_id
+  end
+
+  def assert_not_extracted(url, headers, %{trace_file: trace_file}) do
+    %HTTPoison.Response{status_code: status} = HTTPoison.get!(url, headers)
+
+    [trace] = read_traces(trace_file, 1)
+    [span] = collect_spans(trace)
+
+    assert status == 200
+    assert span["parentSpanId"] == ""
+    assert span["traceId"] != String.duplicate("0", 32)
+  end
+
+  # Uppercase hex is not parsed by the header fast path, the propagator still
+  # accepts it.
+  test "HTTP upstream | uppercase traceparent is extracted by the propagator", ctx do
+    assert_extracted(
+      @host,
+      [{"traceparent", "00-AAD85B4F655FEED4D594A01CFA6A1D62-2A9D49C3E3B7C461-01"}],
+      "aad85b4f655feed4d594a01cfa6a1d62",
+      "2a9d49c3e3b7c461",
+      ctx
+    )
+  end
+
+  test "HTTP upstream | traceparent of another version is extracted by the propagator", ctx do
+    assert_extracted(
+      @host,
+      [{"traceparent", "01-aad85b4f655feed4d594a01cfa6a1d62-2a9d49c3e3b7c461-01"}],
+      "aad85b4f655feed4d594a01cfa6a1d62",
+      "2a9d49c3e3b7c461",
+      ctx
+    )
+  end
+
+  test "HTTP upstream | invalid traceparent is ignored", ctx do
+    assert_not_extracted(
+      @host,
+      [{"traceparent", "00-00000000000000000000000000000000-2a9d49c3e3b7c461-01"}],
+      ctx
+    )
+
+    assert_not_extracted(
+      @host,
+      [{"traceparent", "00-aad85b4f655feed4d594a01cfa6a1d6z-2a9d49c3e3b7c461-01"}],
+      ctx
+    )
+  end
+
+  test "HTTP upstream | uppercase b3 is extracted by the propagator", ctx do
+    assert_extracted(
+      "#{@host}/b3",
+      [{"b3", "AAD85B4F655FEED4D594A01CFA6A1D62-2A9D49C3E3B7C461-1"}],
+      "aad85b4f655feed4d594a01cfa6a1d62",
+      "2a9d49c3e3b7c461",
+      ctx
+    )
+  end
+
+  test "HTTP upstream | b3 with a parent span id is extracted by the propagator", ctx do
+    assert_extracted(
+      "#{@host}/b3",
+      [{"b3", "aad85b4f655feed4d594a01cfa6a1d62-2a9d49c3e3b7c461-1-05e3ac9a4f6e3b90"}],
+      "aad85b4f655feed4d594a01cfa6a1d62",
+      "2a9d49c3e3b7c461",
+      ctx
+    )
+  end
+
+  test "HTTP upstream | uppercase multiheader b3 is extracted by the propagator", ctx do
+    assert_extracted(
+      "#{@host}/b3",
+      [
+        {"X-B3-TraceId", "AAD85B4F655FEED4D594A01CFA6A1D62"},
+        {"X-B3-SpanId", "2A9D49C3E3B7C461"},
+        {"X-B3-Sampled", "1"}
+      ],
+      "aad85b4f655feed4d594a01cfa6a1d62",
+      "2a9d49c3e3b7c461",
+      ctx
+    )
+  end
+
+  test "HTTP upstream | invalid b3 is ignored", ctx do
+    assert_not_extracted("#{@host}/b3", [{"b3", "aad85b4f655feed4d594a01cfa6a1d62-2a9d"}], ctx)
+
+    assert_not_extracted(
+      "#{@host}/b3",
+      [{"b3", "aad85b4f655feed4d594a01cfa6a1d62-000000000000000z-1"}],
+      ctx
+    )
+  end
+
   test "PHP-FPM upstream | span attributes", %{trace_file: trace_file} do
     %HTTPoison.Response{status_code: status} = HTTPoison.get!("#{@host}/app.php")
 
@@ -609,4 +824,195 @@ defmodule InstrumentationTest do
     assert header_trace_id == span["traceId"]
     assert status == 200
   end
+
+  test "Shared span pipeline | spans of several requests share the resource and scope", %{
+    trace_file: trace_file
+  } do
+    paths = ["/shared_a", "/shared_b", "/shared_c"]
+
+    for path <- paths do
+      %HTTPoison.Response{status_code: 200} = HTTPoison.get!("#{@shared_host}#{path}")
+    end
+
+    traces = read_span_traces(trace_file, length(paths), [])
+
+    for trace <- traces do
+      [resource_spans] = collect_resource_spans(trace)
+      [scope_spans] = resource_spans["scopeSpans"]
+
+      assert attrib(resource_spans["resource"], "service.name") == "nginx-shared"
+      assert scope_spans["scope"]["name"] == "nginx"
+    end
+
+    targets =
+      traces
+      |> Enum.flat_map(&collect_spans/1)
+      |> Enum.map(&attrib(&1, "http.target"))
+
+    assert Enum.sort(targets) == Enum.sort(paths)
+  end
+
+  test "Deferred sampler | a 5xx response is kept", %{trace_file: trace_file} do
+    %HTTPoison.Response{status_code: status} = HTTPoison.get!("#{@deferred_host}/error")
+
+    [trace] = read_traces(trace_file, 1)
+    [resource_spans] = collect_resource_spans(trace)
+    [span] = collect_spans(trace)
+
+    assert status == 500
+    assert attrib(resource_spans["resource"], "service.name") == "nginx-deferred"
+    assert attrib(span, "http.status_code") == 500
+    assert attrib(span, "http.target") == "/error"
+  end
+
+  test "Deferred sampler | a slow request is kept", %{trace_file: trace_file} do
+    %HTTPoison.Response{status_code: status} = HTTPoison.get!("#{@deferred_host}/slow")
+
+    [trace] = read_traces(trace_file, 1)
+    [span] = collect_spans(trace)
+
+    assert status == 200
+    assert attrib(span, "http.status_code") == 200
+    assert attrib(span, "http.target") == "/slow"
+
+    duration =
+      String.to_integer(span["endTimeUnixNano"]) - String.to_integer(span["startTimeUnixNano"])
+
+    assert duration >= 200_000_000
+  end
+
+  test "Deferred sampler | a fast 2xx response is dropped", %{trace_file: trace_file} do
+    %HTTPoison.Response{status_code: status} = HTTPoison.get!("#{@deferred_host}/fast")
+
+    assert_raise RuntimeError, "timed out waiting for traces", fn ->
+      read_traces(trace_file, 1)
+    end
+
+    assert status == 200
+  end
+
+  test "Deferred sampler | a request with a sampled parent is kept", %{trace_file: trace_file} do
+    parent_span_id = "2a9d49c3e3b7c461"
+    input_trace_id = "aad85b4f655feed4d594a01cfa6a1d62"
+
+    %HTTPoison.Response{status_code: status} =
+      HTTPoison.get!("#{@deferred_host}/fast", [
+        {"traceparent", "00-#{input_trace_id}-#{parent_span_id}-01"}
+      ])
+
+    [trace] = read_traces(trace_file, 1)
+    [span] = collect_spans(trace)
+
+    assert status == 200
+    assert span["traceId"] == input_trace_id
+    assert span["parentSpanId"] == parent_span_id
+  end
+
+  test "OTLP exporter | spans are exported as gzipped http/json", %{trace_file: trace_file} do
+    %HTTPoison.Response{status_code: status} = HTTPoison.get!("#{@json_host}/json")
+
+    [trace] = read_traces(trace_file, 1)
+    [resource_spans] = collect_resource_spans(trace)
+    [span] = collect_spans(trace)
+
+    assert status == 200
+    assert attrib(resource_spans["resource"], "service.name") == "nginx-json"
+    assert attrib(span, "http.target") == "/json"
+    assert span["name"] == "otel_json"
+  end
+
+  test "OTLP exporter | invalid directive values are rejected" do
+    invalid = [
+      {"opentelemetry_otlp_traces_protocol http/xml", ~s(unknown OTLP protocol "http/xml")},
+      {"opentelemetry_otlp_compression zstd", ~s(unknown OTLP compression "zstd")},
+      {"opentelemetry_otlp_keepalive_requests 0", ~s(invalid OTLP keepalive requests "0")},
+      {"opentelemetry_otlp_keepalive_requests many",
+       ~s(invalid OTLP keepalive requests "many")},
+      {"opentelemetry_otlp_timeout 0", ~s(invalid OTLP timeout "0")},
+      {"opentelemetry_otlp_timeout soon", ~s(invalid OTLP timeout "soon")}
+    ]
+
+    for {directive, message} <- invalid do
+      {output, status} = nginx_config_test(directive)
+
+      assert status != 0, directive
+      assert output =~ message
+    end
+  end
+
+  test "Exit | a worker exits within its flush timeout when the collector is unreachable" do
+    for path <- ["/a", "/b", "/c"] do
+      %HTTPoison.Response{status_code: 200} = HTTPoison.get!("#{@unreachable_host}#{path}")
+    end
+
+    # Let the span and metrics exports start, they would hang for the 30s export timeout.
+    Process.sleep(500)
+
+    start = System.monotonic_time(:millisecond)
+    {_, 0} = System.cmd("docker", ["compose", "stop", "-t", "30", "nginx-unreachable"])
+    elapsed = System.monotonic_time(:millisecond) - start
+
+    # The exit flush timeout is 1s, the rest is the time docker takes to stop the container.
+    assert elapsed < 10_000
+  end
+
+  test "Location metrics | requests and errors are exported per server and location" do
+    metrics_file = File.open!(@metrics_path, [:read])
+    read_until_eof(metrics_file)
+
+    %HTTPoison.Response{status_code: 200} = HTTPoison.get!("#{@host}/metrics")
+    %HTTPoison.Response{status_code: 200} = HTTPoison.get!("#{@host}/metrics")
+    %HTTPoison.Response{status_code: 500} = HTTPoison.get!("#{@host}/metrics_error")
+
+    %HTTPoison.Response{status_code: 200} =
+      HTTPoison.get!("#{@host}/metrics", [{"Host", "otel_metrics"}])
+
+    read_metric_point(metrics_file, "nginx.location.requests", fn point ->
+      location_point?(point, "otel_test", "/metrics") and point["asInt"] == "2"
+    end)
+
+    read_metric_point(metrics_file, "nginx.location.errors", fn point ->
+      location_point?(point, "otel_test", "/metrics_error") and point["asInt"] == "1"
+    end)
+
+    read_metric_point(metrics_file, "nginx.location.duration", fn point ->
+      location_point?(point, "otel_test", "/metrics_error") and point["count"] == "1"
+    end)
+
+    read_metric_point(metrics_file, "nginx.location.requests", fn point ->
+      location_point?(point, "otel_metrics", "/metrics") and point["asInt"] == "1"
+    end)
+
+    File.close(metrics_file)
+  end
+
+  test "Location metrics | servers are not aggregated on their own" do
+    metrics_file = File.open!(@metrics_path, [:read])
+    read_until_eof(metrics_file)
+
+    %HTTPoison.Response{status_code: 404} =
+      HTTPoison.get!("#{@host}/not_a_location", [{"Host", "otel_metrics"}])
+
+    %HTTPoison.Response{status_code: 200} =
+      HTTPoison.get!("#{@host}/server_metrics", [{"Host", "otel_metrics"}])
+
+    # The location is only requested here, after the request outside any location.
+    metrics =
+      read_metrics(
+        metrics_file,
+        fn m ->
+          metric_points(m, "nginx.location.requests")
+          |> Enum.any?(&location_point?(&1, "otel_metrics", "/server_metrics"))
+        end,
+        5_000
+      )
+
+    locations =
+      metric_points(metrics, "nginx.location.requests")
+      |> Enum.map(&attrib(&1, "nginx.location"))
+
+    refute "" in locations
+
+    File.close(metrics_file)
+  end
 end
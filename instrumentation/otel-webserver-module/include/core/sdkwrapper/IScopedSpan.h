@@ -47,6 +47,9 @@ class IScopedSpan {
         virtual void SetStatus(const StatusCode status, const std::string& desc = "") = 0;
 
         virtual SpanKind GetSpanKind() = 0;
+
+        // False when the span was not sampled: attributes, events and status are then dropped.
+        virtual bool IsRecording() = 0;
 };
 
 } //sdkwrapper
@@ -50,6 +50,8 @@ class ScopedSpan : public IScopedSpan {
 
     SpanKind GetSpanKind();
 
+    bool IsRecording() override;
+
 private:
 	opentelemetry::nostd::shared_ptr<trace::Span> mSpan;
 	std::unique_ptr<trace::Scope> mScope;
@@ -53,6 +53,8 @@ class ServerSpan : public IScopedSpan {
 
   SpanKind GetSpanKind();
 
+  bool IsRecording() override;
+
 private:
 	std::unique_ptr<ScopedSpan> mScopedSpan;
     nostd::unique_ptr<context::Token> mToken;
@@ -65,28 +65,33 @@ OTEL_SDK_STATUS_CODE RequestProcessingEngine::startRequest(
     }
 
     std::string spanName = (payload->get_operation_name().empty() ? m_spanNamer->getSpanName(payload->get_uri()) : payload->get_operation_name());
-    otel::core::sdkwrapper::OtelKeyValueMap keyValueMap;
-    keyValueMap[kAttrRequestProtocol] = payload->get_request_protocol();
-    keyValueMap[kAttrHTTPServerName] = payload->get_server_name();
-    keyValueMap[kAttrHTTPMethod] = payload->get_http_request_method();
-    keyValueMap[kAttrHTTPScheme] = payload->get_scheme();
-    keyValueMap[kAttrNetHostName] = payload->get_host();
-    keyValueMap[kAttrNETHostPort] = payload->get_port();
-    keyValueMap[kAttrHTTPTarget] =payload->get_target();
-    keyValueMap[kAttrHTTPFlavor] = payload->get_flavor();
-    keyValueMap[kAttrHTTPClientIP] = payload->get_client_ip();
-    keyValueMap[kAttrHTTPUserAgent] = payload->get_user_agent();
-    keyValueMap[kAttrNETPeerPort] = payload->get_peer_port();
-
-    auto& request_headers = payload->get_request_headers();
-    for (auto itr = request_headers.begin(); itr != request_headers.end(); itr++) {
-        std::string key = std::string(http_request_header) +
-                std::string(itr->first);
-        keyValueMap[key] = itr->second;
+
+    // The sampler decides first, the attributes are only built for recorded spans.
+    auto span = m_sdkWrapper->CreateSpan(spanName, sdkwrapper::SpanKind::SERVER, OtelKeyValueMap{}, payload->get_http_headers());
+    if (span->IsRecording()) {
+        span->AddAttribute(kAttrRequestProtocol, payload->get_request_protocol());
+        span->AddAttribute(kAttrHTTPServerName, payload->get_server_name());
+        span->AddAttribute(kAttrHTTPMethod, payload->get_http_request_method());
+        span->AddAttribute(kAttrHTTPScheme, payload->get_scheme());
+        span->AddAttribute(kAttrNetHostName, payload->get_host());
+        span->AddAttribute(kAttrNETHostPort, payload->get_port());
+        span->AddAttribute(kAttrHTTPTarget, payload->get_target());
+        span->AddAttribute(kAttrHTTPFlavor, payload->get_flavor());
+        span->AddAttribute(kAttrHTTPClientIP, payload->get_client_ip());
+        span->AddAttribute(kAttrHTTPUserAgent, payload->get_user_agent());
+        span->AddAttribute(kAttrNETPeerPort, payload->get_peer_port());
+
+        std::string key(http_request_header);
+        const size_t prefixLength = key.size();
+        auto& request_headers = payload->get_request_headers();
+        for (auto itr = request_headers.begin(); itr != request_headers.end(); itr++) {
+            key.resize(prefixLength);
+            key += itr->first;
+            span->AddAttribute(key, itr->second);
+        }
     }
 
-    auto span = m_sdkWrapper->CreateSpan(spanName, sdkwrapper::SpanKind::SERVER, keyValueMap, payload->get_http_headers());
-    
+
     LOG4CXX_TRACE(mLogger, "Span started for context: [" << wscontext
         <<"] SpanName: " << spanName << ", RequestProtocol: " << payload->get_request_protocol()
         <<" SpanId: " << span.get());
@@ -124,6 +129,14 @@ OTEL_SDK_STATUS_CODE RequestProcessingEngine::endRequest(
         requestContext->removeInteraction();
     }
 
+    // Nothing is recorded on a span which was not sampled.
+    if (!rootSpan->IsRecording()) {
+        LOG4CXX_TRACE(mLogger, "Ending root span with id: " << rootSpan.get());
+        rootSpan->End();
+        delete requestContext;
+        return OTEL_SUCCESS;
+    }
+
     // check for error and set attribute in the scopedSpan.
     if (error) {
         std::stringstream strValue;
@@ -239,6 +252,13 @@ OTEL_SDK_API OTEL_SDK_STATUS_CODE RequestProcessingEngine::endInteraction(
 
     auto interactionSpan = rContext->lastActiveInteraction();
 
+    if (!interactionSpan->IsRecording()) {
+        LOG4CXX_TRACE(mLogger, "Ending Span with id: " << interactionSpan.get());
+        interactionSpan->End();
+        rContext->removeInteraction();
+        return OTEL_SUCCESS;
+    }
+
     // If errorCode is 0 or errMsg is empty, there is no error.
     bool isError = payload->errorCode != 0 && !payload->errorMsg.empty();
     if (isError) {
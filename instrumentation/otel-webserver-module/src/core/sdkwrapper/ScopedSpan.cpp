@@ -81,6 +81,11 @@ SpanKind ScopedSpan::GetSpanKind()
 		return SpanKind::INTERNAL;
 }
 
+bool ScopedSpan::IsRecording()
+{
+	return mSpan->IsRecording();
+}
+
 } //sdkwrapper
 } //core
 } //otel
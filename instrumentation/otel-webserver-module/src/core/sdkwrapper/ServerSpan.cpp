@@ -73,6 +73,11 @@ SpanKind ServerSpan::GetSpanKind()
   return SpanKind::SERVER;
 }
 
+bool ServerSpan::IsRecording()
+{
+  return mScopedSpan->IsRecording();
+}
+
 
 } //sdkwrapper
 } //core
@@ -147,28 +147,34 @@ TEST(TestRequestProcessingEngine, StartRequest)
 	payload.set_peer_port(12345);
 
 
-	otel::core::sdkwrapper::OtelKeyValueMap keyValueMap;
-	keyValueMap[kAttrRequestProtocol] = (opentelemetry::nostd::string_view)"GET";
-	keyValueMap[kAttrHTTPServerName] = (opentelemetry::nostd::string_view)"localhost";
-	keyValueMap[kAttrHTTPMethod] = (opentelemetry::nostd::string_view)"GET";
-	keyValueMap[kAttrNetHostName] =(opentelemetry::nostd::string_view)"host";
-	keyValueMap[kAttrNETHostPort] = (long)80;
-	keyValueMap[kAttrHTTPScheme] = (opentelemetry::nostd::string_view)"http";
-	keyValueMap[kAttrHTTPTarget] = (opentelemetry::nostd::string_view)"target";
-	keyValueMap[kAttrHTTPFlavor] = (opentelemetry::nostd::string_view)"1.1";
-	keyValueMap[kAttrHTTPClientIP] = (opentelemetry::nostd::string_view)"clientip";
-	keyValueMap[kAttrNETPeerPort] = (long)12345;
-	keyValueMap[kAttrHTTPUserAgent] = (opentelemetry::nostd::string_view)"useragent";
+	payload.set_request_headers("Request-Key", "request-value");
+
 	std::shared_ptr<otel::core::sdkwrapper::IScopedSpan> span;
 	span.reset(new MockScopedSpan);
+	auto* mockSpan = (MockScopedSpan*)(span.get());
 
-	// sdkwrapper's create span function should be called
+	// sdkwrapper's create span function should be called, the attributes are
+	// added once the span is known to be recording.
 	EXPECT_CALL(*sdkWrapper, CreateSpan("dummy_span",
 		otel::core::sdkwrapper::SpanKind::SERVER,
-		HasMapVal(keyValueMap),
+		testing::IsEmpty(),
 		payload.get_http_headers())).
 		WillOnce(Return(span));
 
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrRequestProtocol, HasStringVal("GET")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPServerName, HasStringVal("localhost")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPMethod, HasStringVal("GET")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPScheme, HasStringVal("http")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrNetHostName, HasStringVal("host")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrNETHostPort, HasLongIntValue(80)));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPTarget, HasStringVal("target")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPFlavor, HasStringVal("1.1")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPClientIP, HasStringVal("clientip")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrHTTPUserAgent, HasStringVal("useragent")));
+	EXPECT_CALL(*mockSpan, AddAttribute(kAttrNETPeerPort, HasLongIntValue(12345)));
+	EXPECT_CALL(*mockSpan, AddAttribute("http.request.header.Request-Key",
+		HasStringVal("request-value")));
+
 	int* dummy = new int(2);
 	void* reqHandle = dummy;
 	auto res = engine.startRequest("ws_context", &payload, &reqHandle);
@@ -183,6 +189,45 @@ TEST(TestRequestProcessingEngine, StartRequest)
   	delete(dummy);
 }
 
+TEST(TestRequestProcessingEngine, StartRequestNotRecording)
+{
+	FakeRequestProcessingEngine engine;
+	std::shared_ptr<otel::core::TenantConfig> config;
+    auto spanNamer = std::make_shared<otel::core::SpanNamer>();
+	engine.init(config, spanNamer);
+	auto* sdkWrapper = engine.getMockSdkWrapper();
+	ASSERT_TRUE(sdkWrapper);
+	otel::core::RequestPayload payload;
+	payload.set_uri("dummy_span");
+	payload.set_http_request_method("GET");
+	payload.set_request_headers("key", "value");
+
+	std::shared_ptr<otel::core::sdkwrapper::IScopedSpan> span;
+	span.reset(new MockScopedSpan);
+	auto* mockSpan = (MockScopedSpan*)(span.get());
+
+	using testing::_;
+	EXPECT_CALL(*sdkWrapper, CreateSpan("dummy_span",
+		otel::core::sdkwrapper::SpanKind::SERVER, _, _)).
+		WillOnce(Return(span));
+	EXPECT_CALL(*mockSpan, IsRecording()).WillRepeatedly(Return(false));
+
+	// A span dropped by the sampler gets no attribute and no status.
+	EXPECT_CALL(*mockSpan, AddAttribute(_, _)).Times(0);
+	EXPECT_CALL(*mockSpan, SetStatus(_, _)).Times(0);
+	EXPECT_CALL(*mockSpan, End()).Times(1);
+
+	void* reqHandle = nullptr;
+	auto res = engine.startRequest("ws_context", &payload, &reqHandle);
+	EXPECT_EQ(res, OTEL_SUCCESS);
+
+	otel::core::ResponsePayload responsePayload;
+	responsePayload.status_code = 200;
+	responsePayload.response_headers["key"] = "value";
+	res = engine.endRequest(reqHandle, nullptr, &responsePayload);
+	EXPECT_EQ(res, OTEL_SUCCESS);
+}
+
 
 TEST(TestRequestProcessingEngine, StartRequestInvalidParams)
 {
@@ -22,6 +22,10 @@
 class MockScopedSpan : public otel::core::sdkwrapper::IScopedSpan
 {
 public:
+    MockScopedSpan() {
+        ON_CALL(*this, IsRecording()).WillByDefault(testing::Return(true));
+    }
+
 	MOCK_METHOD(void,  End,
 		(),
         (override));
@@ -45,6 +49,10 @@ class MockScopedSpan : public otel::core::sdkwrapper::IScopedSpan
     MOCK_METHOD(otel::core::sdkwrapper::SpanKind,  GetSpanKind,
         (),
         (override));
+
+    MOCK_METHOD(bool, IsRecording,
+        (),
+        (override));
 };
 
 // TODO : General MOCK_METHOD command is giving some unexpected errors. Revisit later